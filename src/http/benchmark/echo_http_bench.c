@@ -0,0 +1,253 @@
+/// Echo HTTP server benchmark.
+///
+/// Runs the echo web server on top of epoll and io_uring poller backends,
+/// with handlers executed by worker threads and by the reactor thread (IWN_POLLER_INLINE),
+/// and drives it by keep-alive client connections.
+///
+/// Usage:
+///   ./echo_http_bench [--clients N] [--seconds N] [--threads N] [--port N]
+
+#include "iwn_wf.h"
+#include "iwn_utils.h"
+
+#include <iowow/iwconv.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define MAX_SAMPLES 100000
+
+#define REQUEST \
+  "PUT /echo HTTP/1.1\r\n" \
+  "Host: localhost\r\n" \
+  "Content-Length: 5\r\n" \
+  "\r\n" \
+  "Hello"
+
+static int num_clients = 32;
+static int num_seconds = 5;
+static int num_threads = 4;
+static int port = 9292;
+
+static atomic_bool stop;
+static atomic_long num_requests;
+static atomic_long num_errors;
+
+struct client {
+  pthread_t thr;
+  int       num_samples;
+  int32_t   samples[MAX_SAMPLES]; ///< Request latencies in microseconds
+};
+
+static int _handle_echo(struct iwn_wf_req *req, void *user_data) {
+  iwn_http_response_write(req->http, 200, "text/plain", req->body, (ssize_t) req->body_len);
+  return IWN_WF_RES_PROCESSED;
+}
+
+static int _connect(void) {
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port   = htons(port),
+  };
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  for (int i = 0; i < 100; ++i) {
+    if (connect(fd, (void*) &addr, sizeof(addr)) == 0) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return fd;
+    }
+    usleep(10000);
+  }
+  close(fd);
+  return -1;
+}
+
+/// Reads a single response, returns false on error.
+static bool _read_response(int fd, char *buf, size_t cap) {
+  size_t len = 0;
+  char *body = 0;
+  long clen = -1;
+
+  while (1) {
+    ssize_t rn = read(fd, buf + len, cap - len - 1);
+    if (rn <= 0) {
+      if (rn < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    len += rn;
+    buf[len] = '\0';
+    if (!body) {
+      body = strstr(buf, "\r\n\r\n");
+      if (body) {
+        body += 4;
+        char *cl = iwn_strcasestr(buf, "content-length:");
+        if (!cl || cl > body) {
+          return false;
+        }
+        clen = strtol(cl + sizeof("content-length:") - 1, 0, 10);
+      }
+    }
+    if (body && (buf + len) - body >= clen) {
+      return true;
+    }
+    if (len >= cap - 1) {
+      return false;
+    }
+  }
+}
+
+static int64_t _time_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void* _client(void *d) {
+  struct client *c = d;
+  char buf[4096];
+  int fd = _connect();
+  if (fd < 0) {
+    ++num_errors;
+    return 0;
+  }
+  while (!stop) {
+    int64_t ts = _time_us();
+    if (write(fd, REQUEST, sizeof(REQUEST) - 1) != sizeof(REQUEST) - 1 || !_read_response(fd, buf, sizeof(buf))) {
+      ++num_errors;
+      break;
+    }
+    if (c->num_samples < MAX_SAMPLES) {
+      c->samples[c->num_samples++] = (int32_t) (_time_us() - ts);
+    }
+    ++num_requests;
+  }
+  close(fd);
+  return 0;
+}
+
+static int _cmp_samples(const void *a, const void *b) {
+  return *(const int32_t*) a - *(const int32_t*) b;
+}
+
+/// Returns latency percentile `pc` of all clients samples.
+static int32_t _percentile(struct client *clients, int32_t *all, double pc) {
+  size_t num = 0;
+  for (int i = 0; i < num_clients; ++i) {
+    memcpy(all + num, clients[i].samples, clients[i].num_samples * sizeof(all[0]));
+    num += clients[i].num_samples;
+  }
+  if (!num) {
+    return 0;
+  }
+  qsort(all, num, sizeof(all[0]), _cmp_samples);
+  return all[(size_t) (pc * (num - 1))];
+}
+
+static iwrc _run(uint32_t flags) {
+  iwrc rc = 0;
+  struct iwn_poller *poller = 0;
+  struct iwn_wf_ctx *ctx;
+  pthread_t poll_thr;
+  struct client *clients = 0;
+  int32_t *all = 0;
+  int64_t ts_start, ts_end;
+
+  num_requests = 0;
+  num_errors = 0;
+  stop = false;
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = num_threads,
+    .flags = flags,
+  }, &poller));
+
+  RCC(rc, finish, iwn_wf_create(0, &ctx));
+  RCC(rc, finish, iwn_wf_route(&(struct iwn_wf_route) {
+    .ctx = ctx,
+    .pattern = "/echo",
+    .handler = _handle_echo,
+    .flags = IWN_WF_PUT
+  }, 0));
+  RCC(rc, finish, iwn_wf_server(&(struct iwn_wf_server_spec) {
+    .listen = "127.0.0.1",
+    .port = port,
+    .poller = poller,
+    .socket_queue_size = 1024,
+  }, ctx));
+  RCC(rc, finish, iwn_poller_poll_in_thread(poller, "bench", &poll_thr));
+
+  RCB(finish, clients = calloc(num_clients, sizeof(*clients)));
+  RCB(finish, all = malloc(sizeof(*all) * MAX_SAMPLES * num_clients));
+  iwn_ts(&ts_start);
+  for (int i = 0; i < num_clients; ++i) {
+    pthread_create(&clients[i].thr, 0, _client, &clients[i]);
+  }
+  sleep(num_seconds);
+  stop = true;
+  for (int i = 0; i < num_clients; ++i) {
+    pthread_join(clients[i].thr, 0);
+  }
+  iwn_ts(&ts_end);
+
+  fprintf(stderr, "%-8s %-7s %10.0f req/sec %8ld requests %4ld errors p50: %5dus p99: %6dus\n",
+          iwn_poller_uses_uring(poller) ? "io_uring" : "epoll",
+          (flags & IWN_POLLER_INLINE) ? "inline" : "workers",
+          num_requests * 1000.0 / (ts_end - ts_start),
+          (long) num_requests, (long) num_errors,
+          _percentile(clients, all, 0.5), _percentile(clients, all, 0.99));
+
+  iwn_poller_shutdown_request(poller);
+  pthread_join(poll_thr, 0);
+
+finish:
+  free(all);
+  free(clients);
+  iwn_poller_destroy(&poller);
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  signal(SIGPIPE, SIG_IGN);
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--clients") == 0) {
+      num_clients = iwatoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--seconds") == 0) {
+      num_seconds = iwatoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      num_threads = iwatoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--port") == 0) {
+      port = iwatoi(argv[i + 1]);
+    }
+  }
+
+  RCC(rc, finish, iw_init());
+  fprintf(stderr, "clients: %d threads: %d seconds: %d\n", num_clients, num_threads, num_seconds);
+  RCC(rc, finish, _run(0));
+  RCC(rc, finish, _run(IWN_POLLER_URING));
+  RCC(rc, finish, _run(IWN_POLLER_INLINE));
+  RCC(rc, finish, _run(IWN_POLLER_URING | IWN_POLLER_INLINE));
+
+finish:
+  if (rc) {
+    iwlog_ecode_error3(rc);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/// Heap allocations per request of keep-alive HTTP connection.
+///
+/// Counts calls of malloc(), calloc() and realloc() made by the server
+/// while a single keep-alive client sends requests one by one.
+///
+/// Usage:
+///   ./http_alloc_bench [--requests N] [--port N]
+
+#include "iwn_http_server.h"
+
+#include <iowow/iwlog.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define REQUEST \
+  "PUT /echo HTTP/1.1\r\n" \
+  "Host: localhost\r\n" \
+  "Content-Length: 5\r\n" \
+  "\r\n" \
+  "Hello"
+
+static int num_requests = 20000;
+static int port = 9292;
+
+static struct iwn_poller *poller;
+static atomic_long num_allocs;
+
+#ifdef __GLIBC__
+
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t, size_t);
+extern void* __libc_realloc(void*, size_t);
+
+void* malloc(size_t size) {
+  atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+  return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void *ptr, size_t size) {
+  atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+#endif
+
+static bool _request_handler(struct iwn_http_req *req) {
+  struct iwn_val body = iwn_http_request_body(req);
+  return iwn_http_response_write(req, 200, "text/plain", body.buf, body.len);
+}
+
+static int _connect(void) {
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port   = htons(port),
+  };
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  for (int i = 0; i < 100; ++i) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return -1;
+    }
+    if (connect(fd, (void*) &addr, sizeof(addr)) == 0) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return fd;
+    }
+    close(fd);
+    usleep(10000);
+  }
+  return -1;
+}
+
+static bool _request(int fd) {
+  char buf[1024];
+  size_t len = 0;
+  if (write(fd, REQUEST, sizeof(REQUEST) - 1) != sizeof(REQUEST) - 1) {
+    return false;
+  }
+  while (len < sizeof(buf) - 1) {
+    ssize_t rb = read(fd, buf + len, sizeof(buf) - 1 - len);
+    if (rb < 1) {
+      return false;
+    }
+    len += rb;
+    buf[len] = '\0';
+    char *p = strstr(buf, "\r\n\r\n");
+    if (p && strcmp(p + 4, "Hello") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void* _client(void *d) {
+  int fd = _connect();
+  if (fd < 0) {
+    fprintf(stderr, "Failed to connect to the server\n");
+    goto finish;
+  }
+  for (int i = 0; i < 100; ++i) { // Warm up
+    if (!_request(fd)) {
+      fprintf(stderr, "Request failed\n");
+      goto finish;
+    }
+  }
+  long allocs = num_allocs;
+  for (int i = 0; i < num_requests; ++i) {
+    if (!_request(fd)) {
+      fprintf(stderr, "Request failed\n");
+      goto finish;
+    }
+  }
+  allocs = num_allocs - allocs;
+  fprintf(stderr, "requests: %d allocations: %ld allocations/request: %.2f\n",
+          num_requests, allocs, (double) allocs / num_requests);
+
+finish:
+  if (fd > -1) {
+    close(fd);
+  }
+  iwn_poller_shutdown_request(poller);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t thr;
+  iwlog_init();
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+      num_requests = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    }
+  }
+
+  RCC(rc, finish, iwn_poller_create(1, 1, &poller));
+  RCC(rc, finish, iwn_http_server_create(&(struct iwn_http_server_spec) {
+    .listen = "127.0.0.1",
+    .port = port,
+    .poller = poller,
+    .request_handler = _request_handler,
+  }, 0));
+
+  pthread_create(&thr, 0, _client, 0);
+  iwn_poller_poll(poller);
+  pthread_join(thr, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  if (rc) {
+    iwlog_ecode_error3(rc);
+    return 1;
+  }
+  return 0;
+}
@@ -2,6 +2,7 @@
 ///
 /// Run server:
 ///   ./echo_http_server --ssl
+///   ./echo_http_server --uring
 ///
 /// Client:
 ///  curl -XPUT -d'Hello' http://localhost:8080/echo
@@ -39,10 +40,13 @@ int main(int argc, char *argv[]) {
   iwrc rc = 0;
   bool ssl = false;
   int port = 8080;
+  unsigned poller_flags = 0;
 
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "--ssl") == 0) {
       ssl = true;
+    } else if (strcmp(argv[i], "--uring") == 0) {
+      poller_flags |= IWN_POLLER_URING;
     } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
       port = iwatoi(argv[i + 1]);
     }
@@ -57,7 +61,9 @@ int main(int argc, char *argv[]) {
     .flags = IWN_WF_PUT | IWN_WF_POST
   }, 0));
 
-  RCC(rc, finish, iwn_poller_create(0, 0, &poller));
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .flags = poller_flags
+  }, &poller));
 
   struct iwn_wf_server_spec spec = {
     .listen = "localhost",
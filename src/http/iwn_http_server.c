@@ -8,6 +8,7 @@
 #include "iwn_scheduler.h"
 #include "poller/iwn_direct_poller_adapter.h"
 #include "ssl/iwn_brssl_poller_adapter.h"
+#include "utils/iwn_slab.h"
 
 #include <iowow/iwlog.h>
 #include <iowow/iwutils.h>
@@ -29,10 +30,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 struct server {
   struct iwn_http_server      server;
   struct iwn_http_server_spec spec;
@@ -44,6 +54,9 @@ struct server {
   IWPOOL *pool;
   char    stime_text[32]; ///< Formatted as: `%a, %d %b %Y %T GMT`
   volatile bool https;
+  atomic_int  num_connections; ///< Number of active client connections
+  atomic_bool paused;          ///< Accepting of connections is paused due to overload
+  atomic_bool disposed;        ///< Server listener is disposed
 };
 
 struct token {
@@ -61,6 +74,11 @@ struct tokens_buf {
 struct stream {
   char *buf;
   void  (*buf_free)(void*);
+  const char  *body;           ///< Response body sent after `buf` by gather write
+  void         (*body_free)(void*);
+  ssize_t      body_len;
+  int          body_fd;        ///< Response body file if HS_SF_BODY_FD is set
+  off_t        body_fd_offset;
   struct token token;
   ssize_t      bytes_total;
   ssize_t      capacity;
@@ -91,6 +109,8 @@ struct response {
   const char *body;
   void   (*body_free)(void*);
   size_t body_len;
+  off_t  body_fd_offset;
+  int    body_fd; ///< Body file descriptor or -1
   int    code;
 };
 
@@ -125,6 +145,10 @@ struct client {
   struct response   response;
   struct proxy      proxy;
   struct sockaddr_storage sockaddr;
+  IWXSTR *pipeline; ///< Read ahead bytes of pipelined requests following the current one
+  IWXSTR *wbatch;   ///< Responses to pipelined requests pending to be sent by single write
+  char   *spare_buf[2];  ///< Released stream buffers kept for the next request and response on this connection
+  size_t  spare_size[2]; ///< Allocated sizes of spare_buf
 
   // Web-framework implementation hooks (do not use these in app)
   // TODO: Review it
@@ -134,15 +158,23 @@ struct client {
   void  (*_wf_on_response_headers_write)(struct iwn_http_req*);
 
   atomic_int refs;
+  atomic_int evh_runs; ///< Number of pending runs of client events processing, see _client_process()
   int     fd;
   uint8_t state;     ///< HTTP_SESSION_{INIT,READ,WRITE,NOP}
   uint8_t flags;     ///< HTTP_END_SESSION,HTTP_AUTOMATIC,HTTP_CHUNKED_RESPONSE
+  bool    in_request_handler; ///< Request handler is called synchronously by poller thread
 
   char ip[46]; ///< Client ip address
 };
 
+// Released stream buffers larger than request_buf_size multiplied by this factor are not reused
+#define HTTP_SPARE_BUF_MAX_FACTOR 4
+// Tokens buffers with greater capacity are not reused
+#define HTTP_TOKENS_REUSE_MAX 256
+
 // stream flags
 #define HS_SF_CONSUMED 0x01U
+#define HS_SF_BODY_FD  0x02U
 
 // parser flags
 #define HS_PF_IN_CONTENT_LEN  0x01U
@@ -157,6 +189,9 @@ struct client {
 #define HTTP_SESSION_WRITE 2
 #define HTTP_SESSION_NOP   3
 
+// Interval of load check while accepting of connections is paused
+#define ADMISSION_CHECK_MS 50
+
 // http session flags
 #define HTTP_KEEP_ALIVE       0x01U
 #define HTTP_STREAMED         0x02U
@@ -386,6 +421,10 @@ static char const *_status_text[] = {
 static iwrc _server_ref(struct server *server, struct server **out);
 static void _server_unref(struct server *server);
 static int64_t _proxy_client_on_ready(struct iwn_poller_adapter *pa, void *user_data, uint32_t events);
+static bool _server_overloaded(struct server *server);
+static void _server_resume(struct server *server);
+static void _client_response_setbuf(struct client *client, IWXSTR *xstr);
+static int64_t _client_process(struct client *client);
 
 static void _noop_free(void *ptr) {
   ;
@@ -409,11 +448,86 @@ static void _server_time(struct server *server, char out_buf[32]) {
   pthread_mutex_unlock(&server->mtx);
 }
 
+/// Keeps released buffer allocated by malloc() for reuse by the next request or response.
+/// Kept buffers never exceed `request_buf_max_size` since they may be reused for reading of request.
+/// Returns false if buffer is not kept.
+static bool _client_buf_keep(struct client *client, char *buf, size_t size) {
+  if (!client->server) {
+    return false;
+  }
+  const struct iwn_http_server_spec *spec = &client->server->spec;
+  size_t max = MIN((size_t) (spec->request_buf_size + 1) * HTTP_SPARE_BUF_MAX_FACTOR,
+                   (size_t) spec->request_buf_max_size + 1);
+  if (size > max) {
+    return false;
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (!client->spare_buf[i]) {
+      client->spare_buf[i] = buf;
+      client->spare_size[i] = size;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void _client_buf_release(struct client *client, char *buf, size_t size) {
+  if (buf && !_client_buf_keep(client, buf, size)) {
+    free(buf);
+  }
+}
+
+/// Returns index of the smallest spare buffer having at least `size` bytes or -1.
+static int _client_buf_spare(struct client *client, size_t size) {
+  int idx = -1;
+  for (int i = 0; i < 2; ++i) {
+    if (  client->spare_buf[i] && client->spare_size[i] >= size
+       && (idx < 0 || client->spare_size[i] < client->spare_size[idx])) {
+      idx = i;
+    }
+  }
+  return idx;
+}
+
+/// Returns buffer of at least `size` bytes reusing the spare one if possible.
+static char* _client_buf_acquire(struct client *client, size_t size, size_t *out_size) {
+  int idx = _client_buf_spare(client, size);
+  if (idx > -1) {
+    char *buf = client->spare_buf[idx];
+    *out_size = client->spare_size[idx];
+    client->spare_buf[idx] = 0;
+    client->spare_size[idx] = 0;
+    return buf;
+  }
+  *out_size = size;
+  return malloc(size);
+}
+
+/// Creates response buffer on top of the spare connection buffer if available.
+static IWXSTR* _client_xstr_new(struct client *client) {
+  int idx = _client_buf_spare(client, 0);
+  if (idx > -1) {
+    IWXSTR *xstr = iwxstr_wrap(client->spare_buf[idx], 0, client->spare_size[idx]);
+    if (xstr) {
+      client->spare_buf[idx] = 0;
+      client->spare_size[idx] = 0;
+      return xstr;
+    }
+  }
+  return iwxstr_new();
+}
+
 IW_INLINE void _stream_free_buffer(struct client *client) {
   if (IW_UNLIKELY(client->stream.buf_free)) {
     client->stream.buf_free(client->stream.buf);
   } else {
-    free(client->stream.buf);
+    _client_buf_release(client, client->stream.buf, client->stream.capacity + 1 /* \0 */);
+  }
+  if (client->stream.body_free) {
+    client->stream.body_free((void*) client->stream.body);
+  }
+  if (client->stream.flags & HS_SF_BODY_FD) {
+    close(client->stream.body_fd);
   }
   memset(&client->stream, 0, sizeof(client->stream));
 }
@@ -465,13 +579,101 @@ static void _stream_shift(struct stream *stream) {
     char *dst = stream->buf + stream->anchor;
     char *src = stream->buf + stream->token.index;
     ssize_t bytes = stream->length - stream->token.index;
-    memcpy(dst, src, bytes);
+    memmove(dst, src, bytes);
   }
   stream->token.index = stream->anchor;
   stream->index = stream->anchor + stream->token.len;
   stream->length = stream->index;
 }
 
+// Modes of token delimiters scan
+#define HS_SCAN_TARGET 0 ///< Request target: stops at controls, space and non ASCII bytes
+#define HS_SCAN_VALUE  1 ///< Header value: stops at controls except tab and non ASCII bytes
+
+/// Max instruction set used by scanner: -1 none, 0 scalar, 1 SSE2, 2 AVX2.
+static int _scan_level = 2;
+
+static ssize_t _scan_scalar(const char *p, ssize_t len, int mode) {
+  const unsigned char *u = (const void*) p;
+  ssize_t i = 0;
+  if (mode == HS_SCAN_VALUE) {
+    for ( ; i < len && ((u[i] >= 0x20 && u[i] < 0x7F) || u[i] == '\t'); ++i);
+  } else {
+    for ( ; i < len && u[i] > 0x20 && u[i] < 0x7F; ++i);
+  }
+  return i;
+}
+
+#if defined(__SSE2__)
+
+// Bytes >= 0x80 are negative for signed compare so they fall below `lo` boundary.
+// `allow` is the control byte allowed in token, 0x7F is used as noop.
+
+static ssize_t _scan_sse2(const char *p, ssize_t len, int mode) {
+  const __m128i lo = _mm_set1_epi8(mode == HS_SCAN_VALUE ? 0x20 : 0x21);
+  const __m128i allow = _mm_set1_epi8(mode == HS_SCAN_VALUE ? '\t' : 0x7F);
+  const __m128i del = _mm_set1_epi8(0x7F);
+  ssize_t i = 0;
+  for ( ; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const void*) (p + i));
+    __m128i m = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(v, allow), _mm_cmplt_epi8(v, lo)),
+                             _mm_cmpeq_epi8(v, del));
+    unsigned bits = (unsigned) _mm_movemask_epi8(m);
+    if (bits) {
+      return i + __builtin_ctz(bits);
+    }
+  }
+  return i + _scan_scalar(p + i, len - i, mode);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HS_SCAN_AVX2
+
+__attribute__((target("avx2")))
+static ssize_t _scan_avx2(const char *p, ssize_t len, int mode) {
+  const __m256i lo = _mm256_set1_epi8(mode == HS_SCAN_VALUE ? 0x20 : 0x21);
+  const __m256i allow = _mm256_set1_epi8(mode == HS_SCAN_VALUE ? '\t' : 0x7F);
+  const __m256i del = _mm256_set1_epi8(0x7F);
+  ssize_t i = 0;
+  for ( ; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const void*) (p + i));
+    __m256i m = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(v, allow), _mm256_cmpgt_epi8(lo, v)),
+                                _mm256_cmpeq_epi8(v, del));
+    unsigned bits = (unsigned) _mm256_movemask_epi8(m);
+    if (bits) {
+      return i + __builtin_ctz(bits);
+    }
+  }
+  return i + _scan_sse2(p + i, len - i, mode);
+}
+
+#endif
+#endif
+
+/// Returns length of token data at `p` up to the first delimiter
+/// or the data end if delimiter is not found.
+static ssize_t _scan(const char *p, ssize_t len, int mode) {
+#ifdef HS_SCAN_AVX2
+  if (_scan_level > 1 && len >= 32 && __builtin_cpu_supports("avx2")) {
+    return _scan_avx2(p, len, mode);
+  }
+#endif
+#if defined(__SSE2__)
+  if (_scan_level > 0) {
+    return _scan_sse2(p, len, mode);
+  }
+#endif
+  return _scan_scalar(p, len, mode);
+}
+
+/// Skips bytes of the current long token (request target, header value)
+/// without walking them through the parser state machine.
+static void _stream_scan(struct stream *stream, int mode) {
+  ssize_t n = _scan(stream->buf + stream->index, stream->length - stream->index, mode);
+  stream->index += n;
+  stream->token.len += (int) n;
+}
+
 IW_INLINE void _stream_anchor(struct stream *stream) {
   stream->anchor = stream->index;
 }
@@ -523,6 +725,11 @@ IW_INLINE void _response_body_free(struct response *response) {
     }
     response->body = 0;
   }
+  if (response->body_fd > -1) {
+    close(response->body_fd);
+    response->body_fd = -1;
+  }
+  response->body_len = 0;
 }
 
 IW_INLINE void _response_free(struct client *client) {
@@ -543,7 +750,6 @@ static bool _client_response_error(struct client *client, int code, char *respon
 static void _client_reset(struct client *client) {
   _request_data_free(client);
   _stream_free_buffer(client);
-  _tokens_free_buffer(client);
   _response_free(client);
 }
 
@@ -555,39 +761,99 @@ static void _proxy_destroy(struct client *client) {
   memset(&client->proxy, 0, sizeof(client->proxy));
 }
 
+static struct iwn_slab _client_slab = IWN_SLAB_INITIALIZER("http_client", sizeof(struct client), 0);
+
 static void _client_destroy(struct client *client) {
   if (client) {
     if (client->injected_poller_evh == _proxy_client_on_ready) {
       _proxy_destroy(client);
     }
     _client_reset(client);
+    _tokens_free_buffer(client);
+    free(client->spare_buf[0]);
+    free(client->spare_buf[1]);
+    iwxstr_destroy(client->pipeline);
+    iwxstr_destroy(client->wbatch);
     if (client->server) {
-      _server_unref(client->server);
+      struct server *server = client->server;
+      --server->num_connections;
+      if (  server->paused && !server->disposed
+         && iwn_poller_alive(server->spec.poller) && !_server_overloaded(server)) {
+        _server_resume(server);
+      }
+      _server_unref(server);
     }
     pthread_mutex_destroy(&client->request.user_mtx);
     iwpool_destroy(client->pool);
+    iwn_slab_free(&_client_slab, client);
   }
 }
 
+/// Client memory pool is created on demand since it is used by proxy requests only.
+static IWPOOL* _client_pool(struct client *client) {
+  if (!client->pool) {
+    client->pool = iwpool_create_empty();
+  }
+  return client->pool;
+}
+
 static void _client_unref(struct client *client) {
   if (--client->refs == 0) {
     _client_destroy(client);
   }
 }
 
+IW_INLINE bool _client_pipeline_pending(struct client *client) {
+  return client->pipeline && iwxstr_size(client->pipeline) > 0;
+}
+
+/// Keeps read ahead bytes of pipelined requests placed behind the current request.
+static bool _client_pipeline_save(struct client *client, const char *buf, ssize_t len) {
+  if (len < 1) {
+    return true;
+  }
+  if (!client->pipeline) {
+    client->pipeline = iwxstr_new2(len);
+    if (!client->pipeline) {
+      return false;
+    }
+  }
+  return iwxstr_cat(client->pipeline, buf, len) == 0;
+}
+
 static iwrc _client_init(struct client *client) {
   iwrc rc = 0;
   _client_reset(client);
+  if (_client_pipeline_pending(client)) {
+    // Continue with already read bytes of pipelined requests
+    struct stream *stream = &client->stream;
+    ssize_t len = iwxstr_size(client->pipeline);
+    size_t size;
+    stream->buf = _client_buf_acquire(client, MAX(len, client->server->spec.request_buf_size) + 1 /* \0 */, &size);
+    if (!stream->buf) {
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
+    memcpy(stream->buf, iwxstr_ptr(client->pipeline), len);
+    stream->length = len;
+    stream->capacity = size - 1;
+    iwxstr_clear(client->pipeline);
+  }
   client->flags = HTTP_AUTOMATIC;
   memset(&client->parser, 0, sizeof(client->parser));
   client->chunk_cb = 0;
-  client->tokens.capacity = 32;
   client->tokens.size = 0;
-  client->tokens.buf = malloc(sizeof(client->tokens.buf[0]) * client->tokens.capacity);
+  if (client->tokens.capacity > HTTP_TOKENS_REUSE_MAX) {
+    _tokens_free_buffer(client);
+  }
   if (!client->tokens.buf) {
-    client->tokens.capacity = 0;
-    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
-    goto finish;
+    client->tokens.capacity = 32;
+    client->tokens.buf = malloc(sizeof(client->tokens.buf[0]) * client->tokens.capacity);
+    if (!client->tokens.buf) {
+      client->tokens.capacity = 0;
+      rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+      goto finish;
+    }
   }
   if (client->server->spec.request_timeout_sec > 0) {
     iwn_poller_set_timeout(client->server->spec.poller, client->fd, client->server->spec.request_timeout_sec);
@@ -597,13 +863,83 @@ finish:
   return rc;
 }
 
+static ssize_t _body_fd_write_buffered(struct iwn_poller_adapter *pa, int fd, off_t offset, size_t len) {
+  char buf[16384];
+  ssize_t bytes = pread(fd, buf, MIN(len, sizeof(buf)), offset);
+  if (bytes > 0) {
+    bytes = pa->write(pa, (uint8_t*) buf, bytes);
+  }
+  return bytes;
+}
+
+/// Writes response headers followed by the body read from file descriptor.
+static bool _client_write_body_fd(struct client *client) {
+  struct iwn_poller_adapter *pa = client->request.poller_adapter;
+  struct stream *stream = &client->stream;
+  ssize_t bytes;
+  if (stream->bytes_total < stream->length) {
+    bytes = pa->write(pa, (uint8_t*) stream->buf + stream->bytes_total, stream->length - stream->bytes_total);
+    if (bytes > 0) {
+      stream->bytes_total += bytes;
+    }
+    if (stream->bytes_total < stream->length) {
+      return errno != EPIPE;
+    }
+  }
+  off_t offset = stream->body_fd_offset + stream->bytes_total - stream->length;
+  size_t len = stream->length + stream->body_len - stream->bytes_total;
+#ifdef __linux__
+  if (!client->server->https) {
+    // Data goes from the page cache directly to the socket
+    bytes = sendfile(pa->fd, stream->body_fd, &offset, len);
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      iwn_poller_edge_drained(pa->poller, pa->fd, IWN_POLLOUT);
+    }
+  } else {
+    bytes = _body_fd_write_buffered(pa, stream->body_fd, offset, len);
+  }
+#else
+  bytes = _body_fd_write_buffered(pa, stream->body_fd, offset, len);
+#endif
+  if (bytes > 0) {
+    stream->bytes_total += bytes;
+    return true;
+  }
+  // Zero bytes means the file was truncated
+  return bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
 IW_INLINE bool _client_write_bytes(struct client *client) {
   struct iwn_poller_adapter *pa = client->request.poller_adapter;
   struct stream *stream = &client->stream;
-  if (stream->length > stream->bytes_total) {
-    ssize_t bytes = pa->write(pa,
-                              (uint8_t*) stream->buf + stream->bytes_total,
-                              stream->length - stream->bytes_total);
+  if (stream->length + stream->body_len > stream->bytes_total) {
+    ssize_t bytes;
+    if (stream->flags & HS_SF_BODY_FD) {
+      return _client_write_body_fd(client);
+    } else if (stream->body_len == 0) {
+      bytes = pa->write(pa,
+                        (uint8_t*) stream->buf + stream->bytes_total,
+                        stream->length - stream->bytes_total);
+    } else if (stream->bytes_total < stream->length && pa->writev) {
+      bytes = pa->writev(pa, (struct iovec[]) {
+        { stream->buf + stream->bytes_total, stream->length - stream->bytes_total },
+        { (void*) stream->body, stream->body_len }
+      }, 2);
+    } else if (stream->bytes_total < stream->length) {
+      // No gather write supported by adapter, write headers and body one by one
+      bytes = pa->write(pa,
+                        (uint8_t*) stream->buf + stream->bytes_total,
+                        stream->length - stream->bytes_total);
+      if (bytes == stream->length - stream->bytes_total) {
+        ssize_t rb = pa->write(pa, (uint8_t*) stream->body, stream->body_len);
+        if (rb > 0) {
+          bytes += rb;
+        }
+      }
+    } else {
+      ssize_t offset = stream->bytes_total - stream->length;
+      bytes = pa->write(pa, (uint8_t*) stream->body + offset, stream->body_len - offset);
+    }
     if (bytes > 0) {
       stream->bytes_total += bytes;
     }
@@ -613,6 +949,46 @@ IW_INLINE bool _client_write_bytes(struct client *client) {
   }
 }
 
+/// Copies unsent data of response body not owned by the server
+/// since the caller may release the body right after response end call.
+static bool _stream_body_detach(struct stream *stream) {
+  ssize_t len = stream->length + stream->body_len - stream->bytes_total;
+  ssize_t body_len = MIN(len, stream->body_len);
+  char *buf = malloc(len + 1);
+  if (!buf) {
+    return false;
+  }
+  memcpy(buf, stream->buf + stream->bytes_total, len - body_len);
+  memcpy(buf + len - body_len, stream->body + stream->body_len - body_len, body_len);
+  if (IW_UNLIKELY(stream->buf_free)) {
+    stream->buf_free(stream->buf);
+    stream->buf_free = 0;
+  } else {
+    free(stream->buf);
+  }
+  stream->buf = buf;
+  stream->length = len;
+  stream->capacity = len;
+  stream->bytes_total = 0;
+  stream->body = 0;
+  stream->body_len = 0;
+  return true;
+}
+
+/// Processes pipelined requests of keep-alive connection on poller worker thread.
+static void _client_pipeline_resume(void *d) {
+  struct client *client = d;
+  int fd = client->fd;
+  if (fd > -1 && iwn_poller_fd_ref(client->poller, fd, 1)) {
+    // Check the slot still belongs to this client
+    if (client->fd == fd && _client_process(client) < 0) {
+      iwn_poller_remove(client->poller, fd);
+    }
+    iwn_poller_fd_ref(client->poller, fd, -1);
+  }
+  _client_unref(client);
+}
+
 static void _client_write(struct client *client) {
   iwrc rc = 0;
   struct stream *stream = &client->stream;
@@ -623,7 +999,11 @@ again:
     client->flags |= HTTP_END_SESSION;
     return;
   }
-  if (stream->bytes_total != stream->length || pa->has_pending_write_bytes(pa)) {
+  if (stream->bytes_total != stream->length + stream->body_len || pa->has_pending_write_bytes(pa)) {
+    if (stream->body && !stream->body_free && !_stream_body_detach(stream)) {
+      client->flags |= HTTP_END_SESSION;
+      return;
+    }
     rc = pa->arm(pa, IWN_POLLOUT);
   } else if (client->flags & (HTTP_CHUNKED_RESPONSE | HTTP_STREAM_RESPONSE)) {
     _stream_free_buffer(client);
@@ -645,7 +1025,18 @@ again:
       }
     } else if (client->flags & HTTP_KEEP_ALIVE) {
       client->state = HTTP_SESSION_INIT;
-      if (client->server->spec.request_timeout_keepalive_sec > 0) {
+      if (_client_pipeline_pending(client)) {
+        // No socket event will be fired for already read pipelined requests.
+        // If client is not processed right now, process them by poller worker.
+        if (atomic_fetch_add(&client->evh_runs, 1) == 0) {
+          ++client->refs;
+          rc = iwn_poller_task(client->poller, _client_pipeline_resume, client);
+          if (rc) {
+            --client->evh_runs;
+            --client->refs;
+          }
+        }
+      } else if (client->server->spec.request_timeout_keepalive_sec > 0) {
         iwn_poller_set_timeout(client->server->spec.poller, client->fd,
                                client->server->spec.request_timeout_keepalive_sec);
       }
@@ -668,13 +1059,14 @@ static bool _client_read_bytes(struct client *client) {
     return true;
   }
   if (!stream->buf) {
+    size_t size;
     stream->length = 0;
     stream->capacity = 0;
-    stream->buf = malloc(server->spec.request_buf_size + 1 /* \0 */);
+    stream->buf = _client_buf_acquire(client, server->spec.request_buf_size + 1 /* \0 */, &size);
     if (!stream->buf) {
       return false;
     }
-    stream->capacity = server->spec.request_buf_size;
+    stream->capacity = size - 1;
   }
   ssize_t bytes;
   do {
@@ -684,11 +1076,14 @@ static bool _client_read_bytes(struct client *client) {
       stream->bytes_total += bytes;
     }
     if (stream->length == stream->capacity) {
-      if (stream->capacity != server->spec.request_buf_max_size) {
+      if (stream->capacity < server->spec.request_buf_max_size) {
         ssize_t ncap = stream->capacity * 2;
         if (ncap > server->spec.request_buf_max_size) {
           ncap = server->spec.request_buf_max_size;
         }
+        if (ncap <= stream->capacity) {
+          break;
+        }
         char *nbuf = realloc(stream->buf, ncap + 1 /* \0 */);
         if (!nbuf) {
           bytes = 0;
@@ -899,7 +1294,7 @@ static void _proxy_endpoint_on_dispose(const struct iwn_poller_task *t) {
       iwn_poller_arm_events(t->poller, fd, IWN_POLLOUT);
     }
     fd = client->proxy.fd_timeout;
-    if (fd > -1) { // Close timeout checker
+    if (fd != -1) { // Close timeout checker
       iwn_poller_remove(t->poller, fd);
     }
     _client_unref(client);
@@ -973,7 +1368,7 @@ static int64_t _proxy_endpoint_on_ready(const struct iwn_poller_task *t, uint32_
         iwlog_ecode_error(proxy->rc, "Proxy | Connection to the proxy endpoint: %s failed", proxy->url_raw);
       }
       int fd = proxy->fd_timeout;
-      if (fd > -1) { // Cancel connection timeout watcher
+      if (fd != -1) { // Cancel connection timeout watcher
         iwn_poller_remove(t->poller, fd);
       }
       return -1;
@@ -1150,6 +1545,7 @@ static iwrc _proxy_to_client_write_lk(struct client *client) {
       if (errno == EINTR) {
         continue;
       } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        iwn_poller_edge_drained(client->poller, client->fd, IWN_POLLOUT);
         break;
       }
       rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
@@ -1172,6 +1568,7 @@ static iwrc _proxy_from_client_read_lk(struct client *client) {
       if (errno == EINTR) {
         continue;
       } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        iwn_poller_edge_drained(client->poller, client->fd, IWN_POLLIN);
         break;
       }
       rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
@@ -1257,7 +1654,7 @@ static bool _proxy_init(struct client *client) {
   rc = _proxy_endpoint_connect(client);
   if (rc) {
     // Restore the original stream buffer
-    client->stream.capacity = iwxstr_asize(proxy->to_endpoint_buf);
+    client->stream.capacity = iwxstr_asize(proxy->to_endpoint_buf) - 1 /* \0 */;
     client->stream.length = iwxstr_size(proxy->to_endpoint_buf);
     client->stream.buf = iwxstr_destroy_keep_ptr(proxy->to_endpoint_buf);
     proxy->to_endpoint_buf = 0;
@@ -1312,16 +1709,20 @@ bool iwn_http_proxy_header_set(
   ssize_t              header_value_len
   ) {
   struct client *client = (void*) req;
+  IWPOOL *pool = _client_pool(client);
+  if (!pool) {
+    return false;
+  }
   size_t header_name_len = strlen(header_name);
-  char *hname = iwpool_strndup2(client->pool, header_name, header_name_len);
+  char *hname = iwpool_strndup2(pool, header_name, header_name_len);
   if (!hname) {
     return false;
   }
-  char *hvalue = iwpool_strndup2(client->pool, header_value, header_value_len);
+  char *hvalue = iwpool_strndup2(pool, header_value, header_value_len);
   if (!hvalue) {
     return false;
   }
-  return iwn_pair_add_pool(client->pool,
+  return iwn_pair_add_pool(pool,
                            &client->proxy.headers,
                            hname, header_name_len,
                            hvalue, header_value_len) == 0;
@@ -1343,8 +1744,10 @@ bool iwn_http_proxy_url_set(struct iwn_http_req *req, const char *url, ssize_t u
   }
 
   char *urlbuf;
-  RCB(finish, urlbuf = iwpool_strndup2(client->pool, url, url_len));
-  RCB(finish, client->proxy.url_raw = iwpool_strndup2(client->pool, url, url_len));
+  IWPOOL *pool;
+  RCB(finish, pool = _client_pool(client));
+  RCB(finish, urlbuf = iwpool_strndup2(pool, url, url_len));
+  RCB(finish, client->proxy.url_raw = iwpool_strndup2(pool, url, url_len));
 
   if (iwn_url_parse(&proxy->url, urlbuf) == -1) {
     rc = IW_ERROR_INVALID_VALUE;
@@ -1400,7 +1803,19 @@ struct token _token_parse(struct client *client) {
   }
 
   char c = 0;
-  while (_stream_next(stream, &c)) {
+  while (1) {
+    if (_scan_level >= 0) {
+      if (parser->state == HV) {
+        if (parser->meta != M_MCK && parser->meta != M_CLV) { // Value is not inspected
+          _stream_scan(stream, HS_SCAN_VALUE);
+        }
+      } else if (parser->state == TR) {
+        _stream_scan(stream, HS_SCAN_TARGET);
+      }
+    }
+    if (!_stream_next(stream, &c)) {
+      break;
+    }
     int8_t type = c < 0 ? HS_ETC : _ctype[(size_t) c];
     int8_t to = _transitions[parser->state * HS_CHAR_TYPE_LEN + type];
     if (to == HN) { // Headers end
@@ -1448,6 +1863,22 @@ static struct iwn_val _token_get_string(struct client *client, int token_type) {
   return ret;
 }
 
+/// Sends queued responses to the pipelined requests.
+/// Bytes of the incomplete request read so far are parsed again when write completes.
+static void _client_batch_flush(struct client *client) {
+  struct stream *stream = &client->stream;
+  IWXSTR *xstr = client->wbatch;
+  client->wbatch = 0;
+  if (!_client_pipeline_save(client, stream->buf, stream->length)) {
+    iwxstr_destroy(xstr);
+    client->flags |= HTTP_END_SESSION;
+    return;
+  }
+  _client_response_setbuf(client, xstr);
+  client->flags |= HTTP_KEEP_ALIVE;
+  _client_write(client);
+}
+
 static void _client_read(struct client *client) {
   struct token token;
 
@@ -1479,17 +1910,28 @@ again:
       case HS_TOK_ERROR:
         _client_response_error(client, 400, "Bad request");
         break;
-      case HS_TOK_BODY:
+      case HS_TOK_BODY: {
+        struct stream *stream = &client->stream;
         client->state = HTTP_SESSION_NOP;
+        // Bytes behind the request body belong to the pipelined requests
+        if (!_client_pipeline_save(client, stream->buf + stream->index, stream->length - stream->index)) {
+          client->flags |= HTTP_END_SESSION;
+          return;
+        }
+        stream->length = stream->index;
         if (token.len > 0) {
           // We have allocated one extra byte behind client->stream-capacity
-          client->stream.buf[token.index + token.len] = '\0';
+          stream->buf[token.index + token.len] = '\0';
         }
-        if (!client->server->spec.request_handler(&client->request)) {
+        client->in_request_handler = true;
+        bool ok = client->server->spec.request_handler(&client->request);
+        client->in_request_handler = false;
+        if (!ok) {
           client->flags |= HTTP_END_SESSION;
           return;
         }
         break;
+      }
       case HS_TOK_BODY_STREAM:
         client->state = HTTP_SESSION_NOP;
         client->flags |= HTTP_STREAMED;
@@ -1510,6 +1952,52 @@ again:
         break;
     }
   } while (token.type != HS_TOK_NONE && client->state == HTTP_SESSION_READ);
+
+  if (client->wbatch && client->state == HTTP_SESSION_READ) {
+    // No more complete requests available, send responses to the pipelined ones
+    _client_batch_flush(client);
+  }
+}
+
+/// Processes client according to its current state.
+/// Caller must increment `client->evh_runs` before the call, processing is repeated
+/// until all runs requested concurrently by other threads are consumed.
+static int64_t _client_process(struct client *client) {
+  iwrc rc = 0;
+  int runs = 1;
+
+  do {
+    if (client->flags & HTTP_END_SESSION) {
+      continue;
+    }
+    switch (client->state) {
+      case HTTP_SESSION_INIT:
+        RCC(rc, finish, _client_init(client));
+        client->state = HTTP_SESSION_READ;
+      // NOTE: Fallthrough
+      case HTTP_SESSION_READ:
+        _client_read(client);
+        break;
+      case HTTP_SESSION_WRITE:
+        _client_write(client);
+        break;
+    }
+    // Process pipelined requests available in the already read data
+    while (  client->state == HTTP_SESSION_INIT
+          && !(client->flags & HTTP_END_SESSION)
+          && _client_pipeline_pending(client)) {
+      RCC(rc, finish, _client_init(client));
+      _client_read(client);
+    }
+finish:
+    if (rc) {
+      iwlog_ecode_error3(rc);
+      client->flags |= HTTP_END_SESSION;
+      rc = 0;
+    }
+  } while ((runs = atomic_fetch_sub(&client->evh_runs, runs) - runs) > 0);
+
+  return (client->flags & HTTP_END_SESSION) ? -1 : 0;
 }
 
 static int64_t _client_on_poller_adapter_event(struct iwn_poller_adapter *pa, void *user_data, uint32_t events) {
@@ -1521,32 +2009,11 @@ static int64_t _client_on_poller_adapter_event(struct iwn_poller_adapter *pa, vo
   if (client->injected_poller_evh) {
     return client->injected_poller_evh(pa, &client->request, events);
   }
-
-  iwrc rc = 0;
-  int64_t resp = 0;
-
-  switch (client->state) {
-    case HTTP_SESSION_INIT:
-      RCC(rc, finish, _client_init(client));
-      client->state = HTTP_SESSION_READ;
-    // NOTE: Fallthrough
-    case HTTP_SESSION_READ:
-      _client_read(client);
-      break;
-    case HTTP_SESSION_WRITE:
-      _client_write(client);
-      break;
-  }
-  if (client->flags & HTTP_END_SESSION) {
-    resp = -1;
-  }
-
-finish:
-  if (rc) {
-    iwlog_ecode_error3(rc);
-    resp = -1;
+  if (atomic_fetch_add(&client->evh_runs, 1) > 0) {
+    // Client is processed by another thread right now, it will repeat processing for us
+    return 0;
   }
-  return resp;
+  return _client_process(client);
 }
 
 void iwn_http_inject_poller_events_handler(struct iwn_http_req *request, iwn_on_poller_adapter_event eh) {
@@ -1565,22 +2032,16 @@ static void _client_on_poller_adapter_dispose(struct iwn_poller_adapter *pa, voi
 
 static iwrc _client_accept(struct server *server, int fd, struct sockaddr_storage *sockaddr) {
   iwrc rc = 0;
-  IWPOOL *pool = iwpool_create_empty();
-  if (!pool) {
-    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
-    close(fd);
-    return rc;
-  }
-  struct client *client = iwpool_calloc(sizeof(*client), pool);
+  struct client *client = iwn_slab_alloc(&_client_slab);
   if (!client) {
     rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
     goto finish;
   }
-  client->pool = pool;
   client->poller = server->spec.poller;
   client->fd = fd;
   client->proxy.fd = -1;
   client->proxy.fd_timeout = -1;
+  client->response.body_fd = -1;
   client->refs = 1;
   memcpy(&client->sockaddr, sockaddr, sizeof(client->sockaddr));
 
@@ -1605,12 +2066,23 @@ static iwrc _client_accept(struct server *server, int fd, struct sockaddr_storag
   pthread_mutexattr_destroy(&attr);
 
   RCC(rc, finish, _server_ref(server, &client->server));
+  ++server->num_connections;
   client->request.server_user_data = client->server->spec.user_data;
 
   int flags = fcntl(fd, F_GETFL, 0);
   RCN(finish, flags);
   RCN(finish, fcntl(fd, F_SETFL, flags | O_NONBLOCK));
 
+#ifdef SO_BUSY_POLL
+  if (server->spec.socket_busy_poll_us > 0) {
+    int val = server->spec.socket_busy_poll_us;
+    static atomic_bool warned;
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) == -1 && !atomic_exchange(&warned, true)) {
+      iwlog_warn("Failed to set SO_BUSY_POLL on socket: %s", strerror(errno));
+    }
+  }
+#endif
+
   if (server->https) {
     pthread_mutex_lock(&server->mtx_ssl);
     rc = iwn_brssl_server_poller_adapter(&(struct iwn_brssl_server_poller_adapter_spec) {
@@ -1618,7 +2090,7 @@ static iwrc _client_accept(struct server *server, int fd, struct sockaddr_storag
       .certs_in_buffer = server->spec.ssl.certs_in_buffer,
       .certs_len = server->spec.ssl.certs_len,
       .events = IWN_POLLIN,
-      .events_mod = IWN_POLLET,
+      .events_mod = IWN_POLLET | IWN_POLLPERSIST,
       .fd = fd,
       .on_dispose = _client_on_poller_adapter_dispose,
       .on_event = _client_on_poller_adapter_event,
@@ -1635,7 +2107,7 @@ static iwrc _client_accept(struct server *server, int fd, struct sockaddr_storag
       server->spec.poller, fd,
       _client_on_poller_adapter_event,
       _client_on_poller_adapter_dispose,
-      client, IWN_POLLIN, IWN_POLLET,
+      client, IWN_POLLIN, IWN_POLLET | IWN_POLLPERSIST,
       server->spec.request_timeout_sec);
   }
 
@@ -1644,8 +2116,6 @@ finish:
     close(fd);
     if (client) {
       _client_unref(client);
-    } else {
-      iwpool_destroy(pool);
     }
   }
 
@@ -1972,13 +2442,7 @@ iwrc iwn_http_response_header_printf(
 
 void iwn_http_response_body_clear(struct iwn_http_req *request) {
   struct client *client = (void*) request;
-  if (client->response.body) {
-    if (client->response.body_free) {
-      client->response.body_free((void*) client->response.body);
-      client->response.body_free = 0;
-    }
-    client->response.body = 0;
-  }
+  _response_body_free(&client->response);
 }
 
 void iwn_http_response_body_set(
@@ -2001,6 +2465,25 @@ void iwn_http_response_body_set(
   client->response.body_free = body_free;
 }
 
+iwrc iwn_http_response_fd_set(struct iwn_http_req *request, int fd, off_t offset, ssize_t len) {
+  struct client *client = (void*) request;
+  if (fd < 0 || offset < 0) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  if (len < 0) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      return iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+    }
+    len = st.st_size > offset ? st.st_size - offset : 0;
+  }
+  iwn_http_response_body_clear(request);
+  client->response.body_fd = fd;
+  client->response.body_fd_offset = offset;
+  client->response.body_len = len;
+  return 0;
+}
+
 static void _client_autodetect_keep_alive(struct client *client) {
   struct iwn_val val = _token_get_string(client, HS_TOK_VERSION);
   if (val.buf == 0) {
@@ -2022,7 +2505,7 @@ static iwrc _client_response_headers_write(struct client *client, IWXSTR *xstr)
     RCC(rc, finish, iwxstr_printf(xstr, "%s: %s\r\n", h->name, h->value));
   }
   if (!(client->flags & (HTTP_CHUNKED_RESPONSE | HTTP_STREAM_RESPONSE | HTTP_HAS_CONTENT_LEN))) {
-    RCC(rc, finish, iwxstr_printf(xstr, "content-length: %d\r\n", (int) client->response.body_len));
+    RCC(rc, finish, iwxstr_printf(xstr, "content-length: %zu\r\n", client->response.body_len));
   }
   rc = iwxstr_cat(xstr, "\r\n", sizeof("\r\n") - 1);
 
@@ -2071,12 +2554,22 @@ finish:
   return rc;
 }
 
-IW_INLINE void _client_response_setbuf(struct client *client, IWXSTR *xstr) {
+static void _client_response_setbuf(struct client *client, IWXSTR *xstr) {
+  if (client->wbatch) {
+    // Responses to the preceding pipelined requests go first
+    IWXSTR *wbatch = client->wbatch;
+    client->wbatch = 0;
+    if (iwxstr_cat(wbatch, iwxstr_ptr(xstr), iwxstr_size(xstr))) {
+      client->flags |= HTTP_END_SESSION;
+    }
+    iwxstr_destroy(xstr);
+    xstr = wbatch;
+  }
   _stream_free_buffer(client);
   struct stream *s = &client->stream;
   s->length = iwxstr_size(xstr);
+  s->capacity = iwxstr_asize(xstr) - 1 /* \0 */;
   s->buf = iwxstr_destroy_keep_ptr(xstr);
-  s->capacity = s->length;
   client->state = HTTP_SESSION_WRITE;
   _response_free(client);
 }
@@ -2092,21 +2585,85 @@ IW_INLINE void _client_response_setbuf2(struct client *client, char *buf, ssize_
   _response_free(client);
 }
 
+/// Queues response to the pipelined request if the next request is already read.
+/// Queued responses are sent by single write when no more complete requests are available.
+static bool _client_response_batch(struct client *client, IWXSTR *xstr) {
+  if (  !client->in_request_handler
+     || !_client_pipeline_pending(client)
+     || client->request.on_response_completed
+     || client->response.body_fd > -1
+     || (client->flags & (HTTP_KEEP_ALIVE | HTTP_END_SESSION | HTTP_UPGRADE)) != HTTP_KEEP_ALIVE) {
+    return false;
+  }
+  struct response *response = &client->response;
+  if (response->body && iwxstr_cat(xstr, response->body, response->body_len)) {
+    iwxstr_destroy(xstr);
+    client->flags |= HTTP_END_SESSION;
+    return true;
+  }
+  if (!client->wbatch) {
+    client->wbatch = xstr;
+  } else {
+    iwrc rc = iwxstr_cat(client->wbatch, iwxstr_ptr(xstr), iwxstr_size(xstr));
+    iwxstr_destroy(xstr);
+    if (rc) {
+      client->flags |= HTTP_END_SESSION;
+      return true;
+    }
+  }
+  _response_free(client);
+  client->state = HTTP_SESSION_INIT;
+  return true;
+}
+
 iwrc iwn_http_response_end(struct iwn_http_req *request) {
   iwrc rc = 0;
   struct client *client = (void*) request;
   struct response *response = &client->response;
-  IWXSTR *xstr = iwxstr_new();
+  IWXSTR *xstr = _client_xstr_new(client);
   if (!xstr) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
   RCC(rc, finish, _client_response_headers_write_http(client, xstr));
-  if (response->body) {
-    RCC(rc, finish, iwxstr_cat(xstr, response->body, response->body_len));
+  if (_client_response_batch(client, xstr)) {
+    return 0;
+  }
+
+  // Body is sent after headers by gather write without copying
+  const char *body = response->body;
+  void (*body_free)(void*) = response->body_free;
+  int body_fd = response->body_fd;
+  off_t body_fd_offset = response->body_fd_offset;
+  ssize_t body_len = (body || body_fd > -1) ? response->body_len : 0;
+  response->body = 0;
+  response->body_free = 0;
+  response->body_fd = -1;
+
+  // Not owned body may refer to the request data, so request buffer is released after write attempt.
+  // Unsent part of such body is copied by _client_write() before waiting for the socket.
+  char *rbuf = 0;
+  size_t rbuf_size = 0;
+  if (body && !body_free && !client->stream.buf_free) {
+    rbuf = client->stream.buf;
+    rbuf_size = client->stream.capacity + 1 /* \0 */;
+    client->stream.buf = 0;
   }
 
   _client_response_setbuf(client, xstr);
+  client->stream.body = body;
+  client->stream.body_len = body_len;
+  client->stream.body_free = body_free;
+  if (body_fd > -1) {
+    client->stream.flags |= HS_SF_BODY_FD;
+    client->stream.body_fd = body_fd;
+    client->stream.body_fd_offset = body_fd_offset;
+  }
+  if (rbuf && _client_buf_keep(client, rbuf, rbuf_size)) {
+    // Spare buffer is not reused until response is written
+    rbuf = 0;
+  }
   _client_write(client);
+  free(rbuf);
 
 finish:
   if (rc) {
@@ -2121,7 +2678,7 @@ iwrc iwn_http_response_stream_start(
   ) {
   iwrc rc = 0;
   struct client *client = (void*) request;
-  IWXSTR *xstr = iwxstr_new();
+  IWXSTR *xstr = _client_xstr_new(client);
   if (!xstr) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
@@ -2186,7 +2743,7 @@ iwrc iwn_http_response_chunk_write(
   if (body_len < 0) {
     body_len = strlen(body);
   }
-  IWXSTR *xstr = iwxstr_new();
+  IWXSTR *xstr = _client_xstr_new(client);
   if (!xstr) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
@@ -2219,7 +2776,7 @@ finish:
 iwrc iwn_http_response_chunk_end(struct iwn_http_req *request) {
   iwrc rc = 0;
   struct client *client = (void*) request;
-  IWXSTR *xstr = iwxstr_new();
+  IWXSTR *xstr = _client_xstr_new(client);
   if (!xstr) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
@@ -2276,7 +2833,9 @@ bool iwn_http_response_write_jbl(
   RCC(rc, finish, jbl_as_json(jbl, jbl_xstr_json_printer, xstr, 0));
   RCC(rc, finish,
       iwn_http_response_header_set(request, "content-type", "application/json", IW_LLEN("application/json")));
-  iwn_http_response_body_set(request, iwxstr_ptr(xstr), iwxstr_size(xstr), 0);
+  size_t len = iwxstr_size(xstr);
+  iwn_http_response_body_set(request, iwxstr_destroy_keep_ptr(xstr), len, free);
+  xstr = 0;
   rc = iwn_http_response_end(request);
 
 finish:
@@ -2299,7 +2858,9 @@ bool iwn_http_response_write_jbn(
   RCC(rc, finish, jbn_as_json(n, jbl_xstr_json_printer, xstr, 0));
   RCC(rc, finish,
       iwn_http_response_header_set(request, "content-type", "application/json", IW_LLEN("application/json")));
-  iwn_http_response_body_set(request, iwxstr_ptr(xstr), iwxstr_size(xstr), 0);
+  size_t len = iwxstr_size(xstr);
+  iwn_http_response_body_set(request, iwxstr_destroy_keep_ptr(xstr), len, free);
+  xstr = 0;
   rc = iwn_http_response_end(request);
 
 finish:
@@ -2383,14 +2944,54 @@ static void _server_destroy(struct server *server) {
   iwpool_destroy(server->pool);
 }
 
-static int64_t _server_on_ready(const struct iwn_poller_task *t, uint32_t events) {
-  struct server *server = t->user_data;
+/// Returns true if server has exhausted its connections or queued events budget.
+static bool _server_overloaded(struct server *server) {
+  return (server->spec.max_connections > 0 && server->num_connections >= server->spec.max_connections)
+         || (server->spec.max_queued_events > 0
+             && iwn_poller_queue_size(server->spec.poller) >= server->spec.max_queued_events);
+}
+
+static void _server_unref_fn(void *d) {
+  _server_unref(d);
+}
+
+static void _server_admission_check(void *d);
+
+/// Schedules check of server load while accepting of connections is paused.
+static void _server_admission_schedule(struct server *server) {
+  struct server *ref;
+  if (_server_ref(server, &ref)) {
+    return;
+  }
+  iwrc rc = iwn_schedule(&(struct iwn_scheduler_spec) {
+    .task_fn = _server_admission_check,
+    .on_dispose = _server_unref_fn,
+    .user_data = server,
+    .poller = server->spec.poller,
+    .timeout_ms = ADMISSION_CHECK_MS,
+    .prio = IWN_POLLER_PRIO_HIGH,
+  });
+  if (rc) {
+    iwlog_ecode_error3(rc);
+    _server_unref(server);
+  }
+}
+
+static void _server_accept(struct server *server, int fd) {
   int client_fd = 0;
   struct sockaddr_storage sockaddr = { 0 };
   socklen_t sockaddr_len = sizeof(sockaddr);
 
   do {
-    client_fd = accept(t->fd, (struct sockaddr*) &sockaddr, &sockaddr_len);
+    if (_server_overloaded(server)) {
+      // Pending connections are left in the listen backlog until load drops
+      if (!atomic_exchange(&server->paused, true)) {
+        iwlog_debug("HTTP server fd: %d is overloaded, accepting of connections is paused", fd);
+        _server_admission_schedule(server);
+      }
+      break;
+    }
+    client_fd = accept(fd, (struct sockaddr*) &sockaddr, &sockaddr_len);
     if (client_fd == -1) {
       break;
     }
@@ -2399,7 +3000,56 @@ static int64_t _server_on_ready(const struct iwn_poller_task *t, uint32_t events
       iwlog_ecode_error(rc, "Failed to initiate client connection fd: %d", client_fd);
     }
   } while (1);
+}
 
+static void _server_accept_probe(struct iwn_poller *p, void *slot_user_data, void *fn_user_data) {
+  struct server *server = fn_user_data;
+  if (slot_user_data == server) { // Listener slot is still alive, so is its fd
+    _server_accept(server, server->fd);
+  }
+}
+
+static void _server_resume_task(void *d) {
+  struct server *server = d;
+  if (!server->disposed) {
+    iwn_poller_probe(server->spec.poller, server->fd, _server_accept_probe, server);
+  }
+  _server_unref(server);
+}
+
+/// Resumes accepting of connections paused due to overload.
+static void _server_resume(struct server *server) {
+  struct server *ref;
+  if (server->disposed || !atomic_exchange(&server->paused, false) || _server_ref(server, &ref)) {
+    return;
+  }
+  // Listen backlog is drained outside of the current context
+  iwrc rc = iwn_poller_task_prio(server->spec.poller, _server_resume_task, server, IWN_POLLER_PRIO_HIGH);
+  if (rc) {
+    if (iwn_poller_alive(server->spec.poller)) { // Tasks are rejected by poller on shutdown
+      iwlog_ecode_error3(rc);
+    }
+    _server_unref(server);
+  }
+}
+
+static void _server_admission_check(void *d) {
+  struct server *server = d;
+  if (!server->paused || server->disposed) {
+    return;
+  }
+  if (_server_overloaded(server)) {
+    _server_admission_schedule(server);
+  } else {
+    _server_resume(server);
+  }
+}
+
+static int64_t _server_on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  struct server *server = t->user_data;
+  if (!server->paused) {
+    _server_accept(server, t->fd);
+  }
   return 0;
 }
 
@@ -2431,6 +3081,7 @@ static void _server_unref(struct server *server) {
 
 static void _server_on_dispose(const struct iwn_poller_task *t) {
   struct server *server = t->user_data;
+  server->disposed = true;
   _server_unref(server);
 }
 
@@ -2577,7 +3228,7 @@ iwrc iwn_http_server_create(const struct iwn_http_server_spec *spec_, int *out_f
     .on_ready   = _server_on_ready,
     .on_dispose = _server_on_dispose,
     .events     = IWN_POLLIN,
-    .events_mod = IWN_POLLET,
+    .events_mod = IWN_POLLET | IWN_POLLPRIO,
     .poller     = spec->poller
   };
 
@@ -10,6 +10,7 @@
 
 #include <pthread.h>
 #include <stdarg.h>
+#include <sys/types.h>
 
 IW_EXTERN_C_START
 
@@ -76,6 +77,10 @@ struct iwn_http_server_spec {
   int request_timeout_sec;            ///< -1 Disable timeout, 0 Use default timeout: 20sec
   int request_token_max_len;          ///< Default: 8191, Min: 8191
   int request_max_headers_count;      ///< Default:  127
+  int socket_busy_poll_us;            ///< SO_BUSY_POLL of accepted sockets, Linux only. Default: 0 (not set)
+  int max_connections;                ///< Accepting of connections is paused while reached. Default: 0 (unlimited)
+  int max_queued_events;              ///< Accepting of connections is paused while number of poller pending tasks
+                                      ///  reaches this value, see iwn_poller_queue_size(). Default: 0 (unlimited)
 };
 
 /// Creates an instance of http server.
@@ -272,6 +277,16 @@ IW_EXPORT void iwn_http_response_body_set(
   ssize_t     body_len,
   void (     *body_free )(void*));
 
+/// Set response body to be read from the given file descriptor.
+/// On Linux body of plain HTTP connection is sent by `sendfile()` without copying into user space,
+/// TLS connections use buffered reads.
+/// @note File descriptor is owned by the server on success and closed when response is completed.
+/// @param fd File descriptor
+/// @param offset Offset of body data in the file
+/// @param len Body data length, if negative the file is sent from `offset` to the end.
+///
+IW_EXPORT iwrc iwn_http_response_fd_set(struct iwn_http_req*, int fd, off_t offset, ssize_t len);
+
 /// Completes a response for given request.
 /// All response headers, body will be transferred to the client peer.
 ///
@@ -0,0 +1,102 @@
+#include "iwn_tests.h"
+#include "iwn_http_server.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define PORT 9393
+
+static struct iwn_poller *poller;
+
+static bool _request_handler(struct iwn_http_req *req) {
+  return iwn_http_response_write(req, 200, "text/plain", "ok", 2);
+}
+
+static int _connect(void) {
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port   = htons(PORT),
+  };
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  IWN_ASSERT_FATAL(fd > -1);
+  IWN_ASSERT_FATAL(connect(fd, (void*) &addr, sizeof(addr)) == 0);
+  return fd;
+}
+
+/// Sends request and waits for response for up to `timeout_ms`.
+static bool _request(int fd, bool send, int timeout_ms) {
+  const char *req = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  char buf[1024];
+  if (send) {
+    IWN_ASSERT(write(fd, req, strlen(req)) == strlen(req));
+  }
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  if (poll(&pfd, 1, timeout_ms) != 1) {
+    return false;
+  }
+  ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  if (len < 1) {
+    return false;
+  }
+  buf[len] = '\0';
+  return strstr(buf, "200 OK") && strstr(buf, "\r\n\r\nok");
+}
+
+static void* _client(void *d) {
+  for (int i = 0; i < 100; ++i) { // Wait for listener
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(PORT) };
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    int rci = connect(fd, (void*) &addr, sizeof(addr));
+    close(fd);
+    if (rci == 0) {
+      break;
+    }
+    usleep(10000);
+  }
+
+  int fd1 = _connect();
+  IWN_ASSERT(_request(fd1, true, 2000));
+
+  // The second connection is left in the listen backlog while the first one is alive
+  int fd2 = _connect();
+  IWN_ASSERT(!_request(fd2, true, 300));
+
+  close(fd1);
+  IWN_ASSERT(_request(fd2, false, 2000));
+  close(fd2);
+
+  iwn_poller_shutdown_request(poller);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t thr;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create(2, 1, &poller));
+  RCC(rc, finish, iwn_http_server_create(&(struct iwn_http_server_spec) {
+    .listen = "127.0.0.1",
+    .port = PORT,
+    .poller = poller,
+    .request_handler = _request_handler,
+    .max_connections = 1,
+  }, 0));
+
+  pthread_create(&thr, 0, _client, 0);
+  iwn_poller_poll(poller);
+  pthread_join(thr, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
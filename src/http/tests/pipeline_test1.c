@@ -0,0 +1,161 @@
+#include "iwn_tests.h"
+#include "iwn_http_server.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define PORT 9394
+
+static struct iwn_poller *poller;
+static atomic_int num_requests;
+
+static void _async_response(void *d) {
+  struct iwn_http_req *req = d;
+  struct iwn_val target = iwn_http_request_target(req);
+  iwn_http_response_printf(req, 200, "text/plain", "async%.*s", (int) target.len - 6, target.buf + 6);
+}
+
+static bool _request_handler(struct iwn_http_req *req) {
+  ++num_requests;
+  struct iwn_val target = iwn_http_request_target(req);
+  if (target.len >= 6 && strncmp(target.buf, "/async", 6) == 0) {
+    // Response is written by another thread
+    return iwn_poller_task(poller, _async_response, req) == 0;
+  }
+  struct iwn_val body = iwn_http_request_body(req);
+  return iwn_http_response_printf(req, 200, "text/plain", "%.*s:%.*s",
+                                  (int) target.len, target.buf, (int) body.len, body.buf);
+}
+
+static int _connect(void) {
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port   = htons(PORT),
+  };
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  for (int i = 0; i < 100; ++i) { // Wait for listener
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    IWN_ASSERT_FATAL(fd > -1);
+    if (connect(fd, (void*) &addr, sizeof(addr)) == 0) {
+      return fd;
+    }
+    close(fd);
+    usleep(10000);
+  }
+  IWN_ASSERT_FATAL(0);
+  return -1;
+}
+
+static void _send(int fd, const char *data) {
+  size_t len = strlen(data);
+  IWN_ASSERT(write(fd, data, len) == len);
+}
+
+/// Reads responses until `num` response bodies are received.
+static void _read_responses(int fd, int num, char *buf, size_t buf_sz) {
+  size_t len = 0;
+  buf[0] = '\0';
+  while (len < buf_sz - 1) {
+    int cnt = 0;
+    for (const char *p = buf; (p = strstr(p, "\r\n\r\n")); p += 4) {
+      ++cnt;
+    }
+    if (cnt >= num) {
+      // Wait for the body of the last response
+      const char *p = strrchr(buf, '\n');
+      if (p && p[1] != '\0') {
+        break;
+      }
+    }
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, 2000) != 1) {
+      break;
+    }
+    ssize_t rb = read(fd, buf + len, buf_sz - len - 1);
+    if (rb < 1) {
+      break;
+    }
+    len += rb;
+    buf[len] = '\0';
+  }
+}
+
+/// Checks that response bodies are placed in the buffer in the given order.
+static void _check_order(const char *buf, const char **bodies, int num) {
+  const char *p = buf;
+  for (int i = 0; i < num; ++i) {
+    IWN_ASSERT_FATAL(p = strstr(p, "HTTP/1.1 200 OK"));
+    IWN_ASSERT_FATAL(p = strstr(p, "\r\n\r\n"));
+    p += 4;
+    IWN_ASSERT(strncmp(p, bodies[i], strlen(bodies[i])) == 0);
+  }
+  IWN_ASSERT(strstr(p, "HTTP/1.1") == 0);
+}
+
+static void* _client(void *d) {
+  char buf[8192];
+  int fd = _connect();
+
+  // All requests are sent by single write
+  _send(fd,
+        "GET /1 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "POST /2 HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello"
+        "GET /3 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /async HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /5 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  _read_responses(fd, 5, buf, sizeof(buf));
+  _check_order(buf, (const char*[]) { "/1:", "/2:hello", "/3:", "async", "/5:" }, 5);
+
+  // The last pipelined request is split across writes
+  _send(fd,
+        "GET /6 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /7 HTTP/1.1\r\nHo");
+  usleep(100000);
+  _send(fd, "st: localhost\r\n\r\n");
+  _read_responses(fd, 2, buf, sizeof(buf));
+  _check_order(buf, (const char*[]) { "/6:", "/7:" }, 2);
+
+  // Every pipelined request is answered by another thread
+  _send(fd,
+        "GET /async/8 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /async/9 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /async/10 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /11 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+        "GET /async/12 HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  _read_responses(fd, 5, buf, sizeof(buf));
+  _check_order(buf, (const char*[]) { "async/8", "async/9", "async/10", "/11:", "async/12" }, 5);
+
+  close(fd);
+  IWN_ASSERT(num_requests == 12);
+  iwn_poller_shutdown_request(poller);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t thr;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create(2, 1, &poller));
+  RCC(rc, finish, iwn_http_server_create(&(struct iwn_http_server_spec) {
+    .listen = "127.0.0.1",
+    .port = PORT,
+    .poller = poller,
+    .request_handler = _request_handler,
+  }, 0));
+
+  pthread_create(&thr, 0, _client, 0);
+  iwn_poller_poll(poller);
+  pthread_join(thr, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -76,6 +76,12 @@ run() {
 
   diff r1.dat test.dat
   diff r2.dat test.dat
+
+  printf "\n\nFile response:\n"
+  dd if=/dev/urandom of=test.dat bs=4194304 count=1 2> /dev/null
+  curl -sk -o r1.dat ${BASE}/file -o r2.dat ${BASE}/file
+  diff r1.dat test.dat
+  diff r2.dat test.dat
 }
 
 SERVER="./server1 ${SOPTS}"
@@ -10,6 +10,8 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 static struct iwn_poller *poller;
 
@@ -98,6 +100,14 @@ static bool _request_handler(struct iwn_http_req *req) {
     req->on_request_dispose = _on_chunk_req_destroy;
     iwn_http_request_chunk_next(req, _chunk_req_cb);
     goto finish;
+  } else if (iwn_http_request_target_is(req, "/file", -1)) {
+    int fd = open("test.dat", O_RDONLY);
+    RCN(finish, fd);
+    rc = iwn_http_response_fd_set(req, fd, 0, -1);
+    if (rc) {
+      close(fd);
+      goto finish;
+    }
   } else if (iwn_http_request_target_is(req, "/chunked", -1)) {
     RCC(rc, finish, iwn_http_response_header_set(req, "content-type", "text/plain", -1));
     RCC(rc, finish, iwn_http_response_chunk_write(req, "\n4cd009fb-dceb-4907-a6be-dd05c3f052b3",
@@ -0,0 +1,142 @@
+#include "iwn_tests.h"
+#include "iwn_http_server.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define PORT     9395
+#define BODY_LEN (4 * 1024 * 1024)
+
+static struct iwn_poller *poller;
+static atomic_int num_freed;
+
+static char* _body_new(void) {
+  char *body = malloc(BODY_LEN);
+  IWN_ASSERT_FATAL(body);
+  for (int i = 0; i < BODY_LEN; ++i) {
+    body[i] = 'a' + i % 26;
+  }
+  return body;
+}
+
+static void _body_free(void *ptr) {
+  ++num_freed;
+  free(ptr);
+}
+
+static bool _request_handler(struct iwn_http_req *req) {
+  char *body = _body_new();
+  if (iwn_http_request_target_is(req, "/owned", -1)) {
+    iwn_http_response_body_set(req, body, BODY_LEN, _body_free);
+    return iwn_http_response_end(req) == 0;
+  }
+  // Body is not owned by server, it is destroyed right after response call
+  bool ret = iwn_http_response_write(req, 200, "text/plain", body, BODY_LEN);
+  memset(body, 'x', BODY_LEN);
+  free(body);
+  return ret;
+}
+
+static int _connect(void) {
+  struct sockaddr_in addr = {
+    .sin_family = AF_INET,
+    .sin_port   = htons(PORT),
+  };
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  for (int i = 0; i < 100; ++i) { // Wait for listener
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    IWN_ASSERT_FATAL(fd > -1);
+    if (connect(fd, (void*) &addr, sizeof(addr)) == 0) {
+      return fd;
+    }
+    close(fd);
+    usleep(10000);
+  }
+  IWN_ASSERT_FATAL(0);
+  return -1;
+}
+
+/// Sends request, reads response slowly and checks its body.
+static void _request(int fd, const char *target) {
+  char req[256];
+  size_t len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", target);
+  IWN_ASSERT_FATAL(write(fd, req, len) == len);
+  // Let server fill the socket buffer
+  usleep(100000);
+
+  size_t hlen = 0, blen = 0, buf_sz = BODY_LEN + 1024;
+  char *buf = malloc(buf_sz);
+  IWN_ASSERT_FATAL(buf);
+  for (len = 0; len < buf_sz; ) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, 2000) != 1) {
+      break;
+    }
+    ssize_t rb = read(fd, buf + len, buf_sz - len);
+    if (rb < 1) {
+      break;
+    }
+    len += rb;
+    if (!hlen) {
+      char *p = memmem(buf, len, "\r\n\r\n", 4);
+      if (p) {
+        hlen = p - buf + 4;
+      }
+    }
+    if (hlen) {
+      blen = len - hlen;
+      if (blen >= BODY_LEN) {
+        break;
+      }
+    }
+  }
+  IWN_ASSERT(hlen > 0 && strncmp(buf, "HTTP/1.1 200 OK", IW_LLEN("HTTP/1.1 200 OK")) == 0);
+  IWN_ASSERT(blen == BODY_LEN);
+  for (size_t i = 0; hlen > 0 && i < blen; ++i) {
+    if (buf[hlen + i] != 'a' + i % 26) {
+      IWN_ASSERT(buf[hlen + i] == 'a' + i % 26);
+      break;
+    }
+  }
+  free(buf);
+}
+
+static void* _client(void *d) {
+  int fd = _connect();
+  _request(fd, "/");
+  _request(fd, "/owned");
+  close(fd);
+  iwn_poller_shutdown_request(poller);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t thr;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create(2, 1, &poller));
+  RCC(rc, finish, iwn_http_server_create(&(struct iwn_http_server_spec) {
+    .listen = "127.0.0.1",
+    .port = PORT,
+    .poller = poller,
+    .request_handler = _request_handler,
+  }, 0));
+
+  pthread_create(&thr, 0, _client, 0);
+  iwn_poller_poll(poller);
+  pthread_join(thr, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  IWN_ASSERT(num_freed == 1);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
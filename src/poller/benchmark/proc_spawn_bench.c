@@ -0,0 +1,113 @@
+/// Process spawn latency benchmark.
+///
+/// Compares latency of iwn_proc_spawn() calls made by the `fork()` path (used when
+/// iwn_proc_spec::on_fork is set) and by the fast spawn path, while parent process
+/// holds a large touched heap.
+///
+/// Usage:
+///   ./proc_spawn_bench [--heap-mb N] [--spawns N]
+
+#include "iwn_proc.h"
+
+#include <iowow/iwconv.h>
+#include <iowow/iwlog.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+static int heap_mb = 1024;
+static int num_spawns = 200;
+
+static int64_t _time_us(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static int _cmp_samples(const void *a, const void *b) {
+  int64_t x = *(const int64_t*) a, y = *(const int64_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+static void _on_fork(const struct iwn_proc_ctx *ctx, pid_t pid) {
+}
+
+static iwrc _run(struct iwn_poller *poller, const char *name, bool fork) {
+  iwrc rc = 0;
+  int64_t sum = 0, *samples = malloc(num_spawns * sizeof(*samples));
+  if (!samples) {
+    return IW_ERROR_ALLOC;
+  }
+  for (int i = 0; i < num_spawns; ++i) {
+    pid_t pid;
+    int64_t ts = _time_us();
+    RCC(rc, finish, iwn_proc_spawn(&(struct iwn_proc_spec) {
+      .poller = poller,
+      .path = "/bin/true",
+      .on_fork = fork ? _on_fork : 0,
+    }, &pid));
+    samples[i] = _time_us() - ts;
+    sum += samples[i];
+    iwn_proc_wait(pid);
+  }
+  qsort(samples, num_spawns, sizeof(*samples), _cmp_samples);
+  fprintf(stderr, "%-6s spawns: %d avg: %" PRId64 "us p50: %" PRId64 "us p99: %" PRId64 "us max: %" PRId64 "us\n",
+          name, num_spawns, sum / num_spawns, samples[num_spawns / 2],
+          samples[num_spawns * 99 / 100], samples[num_spawns - 1]);
+
+finish:
+  free(samples);
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  struct iwn_poller *poller = 0;
+  pthread_t poll_thr;
+  char *heap = 0;
+  iwlog_init();
+
+  for (int i = 1; i < argc - 1; ++i) {
+    if (strcmp(argv[i], "--heap-mb") == 0) {
+      heap_mb = (int) iwatoi(argv[++i]);
+    } else if (strcmp(argv[i], "--spawns") == 0) {
+      num_spawns = (int) iwatoi(argv[++i]);
+    }
+  }
+  if (num_spawns < 1) {
+    num_spawns = 1;
+  }
+
+  // Touch every page of the heap so fork() has to copy its page tables
+  size_t heap_size = (size_t) heap_mb * 1024 * 1024;
+  if (heap_size) {
+    RCB(finish, heap = malloc(heap_size));
+    memset(heap, 1, heap_size);
+  }
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 1,
+    .flags = IWN_POLLER_POLL_NO_FDS,
+  }, &poller));
+  RCC(rc, finish, iwn_poller_poll_in_thread(poller, "proc_bench", &poll_thr));
+
+  fprintf(stderr, "heap: %dMB\n", heap_mb);
+  RCC(rc, finish, _run(poller, "fork", true));
+  RCC(rc, finish, _run(poller, "spawn", false));
+
+  iwn_poller_shutdown_request(poller);
+  pthread_join(poll_thr, 0);
+
+finish:
+  iwn_proc_dispose();
+  iwn_poller_destroy(&poller);
+  free(heap);
+  if (rc) {
+    iwlog_ecode_error3(rc);
+    return 1;
+  }
+  return 0;
+}
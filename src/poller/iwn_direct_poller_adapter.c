@@ -1,4 +1,5 @@
 #include "iwn_direct_poller_adapter.h"
+#include "iwn_slab.h"
 
 #include <iowow/iwlog.h>
 
@@ -12,6 +13,8 @@ struct pa {
   iwn_on_poller_adapter_dispose on_dispose;
 };
 
+static struct iwn_slab _slab = IWN_SLAB_INITIALIZER("direct_poller_adapter", sizeof(struct pa), 0);
+
 static bool _has_pending_write_bytes(struct iwn_poller_adapter *a) {
   return false;
 }
@@ -20,16 +23,27 @@ static iwrc _arm(struct iwn_poller_adapter *a, uint32_t events) {
   return iwn_poller_arm_events(a->poller, a->fd, events);
 }
 
+IW_INLINE ssize_t _io_result(struct iwn_poller_adapter *a, ssize_t ret, uint32_t events) {
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    iwn_poller_edge_drained(a->poller, a->fd, events);
+  }
+  return ret;
+}
+
 static ssize_t _read(struct iwn_poller_adapter *a, uint8_t *buf, size_t len) {
-  return read(a->fd, buf, len);
+  return _io_result(a, read(a->fd, buf, len), IWN_POLLIN);
 }
 
 static ssize_t _write(struct iwn_poller_adapter *a, const uint8_t *buf, size_t len) {
-  return write(a->fd, buf, len);
+  return _io_result(a, write(a->fd, buf, len), IWN_POLLOUT);
+}
+
+static ssize_t _writev(struct iwn_poller_adapter *a, const struct iovec *iov, int iovcnt) {
+  return _io_result(a, writev(a->fd, iov, iovcnt), IWN_POLLOUT);
 }
 
 IW_INLINE void _destroy(struct pa *a) {
-  free(a);
+  iwn_slab_free(&_slab, a);
 }
 
 static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
@@ -54,7 +68,7 @@ iwrc iwn_direct_poller_adapter(
   long                          timeout_sec
   ) {
   iwrc rc = 0;
-  struct pa *a = calloc(1, sizeof(*a));
+  struct pa *a = iwn_slab_alloc(&_slab);
   if (!a) {
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
@@ -63,6 +77,7 @@ iwrc iwn_direct_poller_adapter(
   a->b.poller = p;
   a->b.read = _read;
   a->b.write = _write;
+  a->b.writev = _writev;
   a->b.arm = _arm;
   a->b.has_pending_write_bytes = _has_pending_write_bytes;
   a->on_event = on_event;
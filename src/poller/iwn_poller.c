@@ -1,14 +1,19 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // CPU affinity API
+#endif
+
 #include "iwn_poller.h"
+#include "iwn_wstp.h"
 
 #include <iowow/iwutils.h>
 #include <iowow/iwlog.h>
 #include <iowow/iwp.h>
 #include <iowow/iwtp.h>
-#include <iowow/iwhmap.h>
 
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <errno.h>
 #include <stdatomic.h>
 #include <unistd.h>
@@ -18,6 +23,11 @@
 #include <string.h>
 #include <sys/socket.h>
 
+#if defined(__linux__)
+#include <sched.h>
+#include <stdio.h>
+#endif
+
 #if defined(IWN_KQUEUE)
 #include <sys/event.h>
 #elif defined(IWN_EPOLL)
@@ -26,14 +36,113 @@
 #include <sys/eventfd.h>
 #endif
 
-#define SLOT_REMOVE_PENDING 0x01U
-#define SLOT_REMOVED        0x02U
-#define SLOT_PROCESSING     0x04U
-#define SLOT_UNSUBSCRIBED   0x08U
+#if defined(IWN_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/// Slot state word layout:
+///   - bits  0..23 Number of slot references
+///   - bits 24..31 SLOT_* flags
+///   - bits 32..47 Events received while slot is processing
+///   - bits 48..63 Events armed while slot is processing or rearming
+#define SLOT_REFS_MASK    0xffffffULL
+#define SLOT_UPDATE_SHIFT 32
+#define SLOT_ARMED_SHIFT  48
+#define SLOT_EVENTS_MASK  0xffffULL
+#define SLOT_UPDATE_MASK  (SLOT_EVENTS_MASK << SLOT_UPDATE_SHIFT)
+#define SLOT_ARMED_MASK   (SLOT_EVENTS_MASK << SLOT_ARMED_SHIFT)
+
+#define SLOT_ACTIVE         0x01000000ULL ///< Slot is in use
+#define SLOT_REMOVE_PENDING 0x02000000ULL
+#define SLOT_REMOVED        0x04000000ULL
+#define SLOT_PROCESSING     0x08000000ULL
+#define SLOT_UNSUBSCRIBED   0x10000000ULL
+#define SLOT_ABORT          0x20000000ULL ///< Error or hangup event received on slot fd
+#define SLOT_REARM          0x40000000ULL ///< Slot events are being rearmed by some thread
+#define SLOT_INIT           0x80000000ULL ///< Slot is being initialized
+
+/// Slot flags of iwn_poller_task::events_mod not passed to the kernel
+#define SLOT_DISPATCH_FLAGS (IWN_POLLINLINE | IWN_POLLBLOCKING | IWN_POLLPERSIST | IWN_POLLPRIO | IWN_POLLBACKGROUND)
+
+#define REF_DESTROY_DEFER 0x01U
+
+#define SLOTS_CHUNK_BITS 10
+#define SLOTS_CHUNK_SIZE (1U << SLOTS_CHUNK_BITS)
+
+#define SHARDS_MAX 256
+#define POLL_THREADS_MAX 64
+#define NUMA_NODES_MAX 64
+#define BUSY_POLL_MAX_US 100000
+#define BUSY_POLL_MIN_US 8
+
+#define CMD_QUEUE_SIZE 1024 ///< Capacity of poller command queue, power of 2
+#define CMD_ARM        0x01U
+#define CMD_REMOVE     0x02U
+
+#define WHEEL_LEVELS     6  ///< Number of timing wheel levels, wheel covers 64^6 ms (~2 years)
+#define WHEEL_BITS       6
+#define WHEEL_SIZE       (1U << WHEEL_BITS)
+#define WHEEL_MASK       (WHEEL_SIZE - 1)
+#define WHEEL_SLACK_MASK 0xfLL ///< Inactivity deadlines are rounded up to 16ms to coalesce timer wakeups
+
+#if defined(IWN_EPOLL)
+#define SERVICE_FDS 2 ///< Number of internal fds (eventfd, timerfd) managed by every poller shard
+#elif defined(IWN_KQUEUE)
+#define SERVICE_FDS 0
+#endif
+
+struct poller_slot;
+
+/// Directory of slot chunks indexed by fd.
+/// Slot chunks are never freed while poller is alive so slots can be accessed without locks.
+/// Outgrown directories are retired and disposed along with poller.
+struct slots_dir {
+  uint32_t num;                          ///< Number of chunks
+  struct slots_dir *retired;             ///< Previous directory
+  _Atomic(struct poller_slot*) chunks[]; ///< Chunks of SLOTS_CHUNK_SIZE slots
+};
+
+/// Entry of timing wheel.
+struct wheel_node {
+  struct wheel_node *next;
+  struct wheel_node *prev;
+  _Atomic int64_t    expire; ///< Wheel time of node in milliseconds, zero if node is not linked
+  uint32_t bucket;           ///< Index of wheel bucket the node is linked to
+};
+
+/// Hierarchical timing wheel with millisecond tick.
+/// Level `L` has WHEEL_SIZE buckets each covering 64^L milliseconds. Nodes are moved
+/// to lower levels when wheel time reaches start of their bucket.
+struct wheel {
+  int64_t  now;                                         ///< Wheel time, all nodes expire after it
+  int64_t  armed;                                       ///< Time timer is armed at, INT64_MAX if not armed
+  uint64_t occupied[WHEEL_LEVELS];                      ///< Bitmaps of non empty buckets
+  struct wheel_node *buckets[WHEEL_LEVELS * WHEEL_SIZE];
+  pthread_mutex_t    mtx;
+};
+
+/// Command submitted to the poller shard by a foreign thread.
+struct cmd {
+  int      fd;
+  uint32_t gen;    ///< Slot generation at the time of submission
+  uint32_t events; ///< Events to arm
+  uint32_t op;     ///< CMD_ARM or CMD_REMOVE
+};
+
+struct cmd_cell {
+  atomic_size_t seq;
+  struct cmd    cmd;
+};
 
-#define REF_SET_LOCKED    0x01U
-#define REF_LOCKED        0x02U
-#define REF_DESTROY_DEFER 0x04U
+/// Bounded lock-free queue of commands (D. Vyukov's MPMC ring).
+struct cmd_queue {
+  _Alignas(64) atomic_size_t head; ///< Consumer position
+  _Alignas(64) atomic_size_t tail; ///< Producer position
+  _Alignas(64) atomic_int pending; ///< Number of submitted commands not executed yet
+  struct cmd_cell cells[CMD_QUEUE_SIZE];
+};
 
 struct iwn_poller {
   int fd;
@@ -42,25 +151,49 @@ struct iwn_poller {
   int timer_fd;        ///< fd to set up timeouts
 #endif
 
-#ifdef IWN_KQUEUE
-  int identity_seq;
+#ifdef IWN_URING
+  struct uring *uring; ///< io_uring backend used instead of epoll if set
 #endif
 
-  int fds_count;              ///< Numbver of active file descriptors
-  int max_poll_events;        ///< Max wait epoll_wait fd events at once
+  _Atomic(struct slots_dir*) tslots; ///< Slots of IWN_POLLTIMEOUT tasks indexed by timer handle
+  uint32_t *tfree;                   ///< Stack of released timer indexes, guarded by `mtx`
+  uint32_t  tfree_num;
+  uint32_t  tfree_cap;
+  uint32_t  tnext;                   ///< Next never used timer index, guarded by `mtx`
 
-  atomic_long timeout_next;      ///< Next timeout check
-  atomic_long timeout_checktime; ///< Last time of timeout check
-
-  IWTP    tp;
-  IWHMAP *slots;
-  char   *thread_name;
+  atomic_int fds_count;       ///< Numbver of active file descriptors
+  int max_poll_events;        ///< Max wait epoll_wait fd events at once
 
-  pthread_mutex_t mtx;
-  uint32_t flags; ///< Poller mode flags. See iwn_poller_flags_set()
+  struct wheel wheel; ///< Inactivity timeouts of slots
+
+  IWTP tp;
+  IWN_WSTP wstp;                    ///< Work stealing pool used instead of `tp` if set
+  IWTP tp_prio;                     ///< Workers of high priority lane, zero if lane is served by `tp`
+  IWTP tp_bg;                       ///< Workers of background lane, zero if lane is served by `tp`
+  _Atomic(struct slots_dir*) slots; ///< Slots indexed by fd
+  char *thread_name;
+
+  pthread_mutex_t mtx; ///< Guards slot directories growth
+  uint32_t flags;      ///< Poller mode flags. See iwn_poller_flags_set()
+
+  _Atomic(struct stats_block*) stats; ///< Statistics counters of threads served this poller
+  uint64_t stats_id;                  ///< Unique poller id to match thread local statistics block
+
+  struct iwn_poller  *root;   ///< Root poller of shards set or self if poller is not sharded
+  struct iwn_poller **shards; ///< Shards of root poller, zero if poller is not sharded
+  int num_shards;             ///< Number of shards in root poller
+  int idx;                    ///< Index of shard in root poller
+  atomic_uint task_seq;       ///< Round-robin counter to spread iwn_poller_task() over shards
+  int num_poll_threads;       ///< Number of threads polling events of this poller
+  atomic_int poll_threads;    ///< Number of threads running poll loop, the last one cleans up poller
+  int busy_poll_us;           ///< Max busy polling time in microseconds before blocking, zero if disabled
+  atomic_int busy_poll_budget;///< Current adaptive busy polling time in microseconds
+  struct cmd_queue *cmdq;     ///< Queue of commands from foreign threads, zero if IWN_POLLER_CMD_QUEUE is not set
+#if defined(__linux__)
+  cpu_set_t *cpuset;          ///< CPU cores poll and worker threads are pinned to, zero if not set
+#endif
 
   volatile bool stop;
-  volatile bool housekeeping;          ///< CAS barrier for timeout cleaner
 };
 
 struct poller_slot {
@@ -73,43 +206,778 @@ struct poller_slot {
   long     timeout;                                      ///< Optional slot timeout
   struct iwn_poller *poller;                             ///< Poller
 
-  int      refs;
-  uint32_t events_processing;
-  uint32_t events_update;
-  uint32_t events_armed;
-  uint32_t flags;
-  atomic_long timeout_limit;           ///< Limit in seconds for use with time function.
+  _Atomic uint64_t state;              ///< Slot state, see SLOT_* masks
+  uint32_t    gen;                     ///< Slot generation, even number bumped every time the slot is reused
+  uint32_t    events_processing;
+  int64_t     dispatched_us;           ///< Time slot events dispatched at in microseconds, zero if unknown
+  _Atomic int64_t timeout_limit;       ///< Inactivity deadline in milliseconds, INT64_MAX if not set
+  struct wheel_node tnode;             ///< Timing wheel entry
+#ifdef IWN_EPOLL
+  _Atomic uint64_t edge;               ///< Edge triggered slot events: interest << 32 | tick << 16 | ready
+  atomic_uint edge_tick;               ///< Tick of edge ready events at the time slot events dispatched
+#endif
+#ifdef IWN_URING
+  atomic_uint polling;                 ///< Events mask of pending io_uring poll request, zero if none
+  uint32_t    poll_epoch;              ///< Low bit of generation in user data of pending poll request
+#endif
 
   struct poller_slot *next;
-  bool destroy_cas;
-  bool abort;
 };
 
-IW_INLINE time_t _time_sec() {
+/// Statistics histogram updated by a single thread.
+struct stats_hist {
+  atomic_uint_fast64_t count;
+  atomic_uint_fast64_t sum;
+  atomic_uint_fast64_t max;
+  atomic_uint_fast64_t buckets[IWN_POLLER_HISTOGRAM_BUCKETS];
+};
+
+/// Statistics counters of a thread. Every counter has a single writer thread
+/// so it is updated without atomic read-modify-write operations.
+struct stats_block {
+  pthread_t thread;
+  struct stats_block  *next;
+  atomic_uint_fast64_t polls;
+  atomic_uint_fast64_t events;
+  atomic_uint_fast64_t dispatches;
+  atomic_uint_fast64_t inline_dispatches;
+  atomic_uint_fast64_t updates;
+  atomic_uint_fast64_t rearms;
+  atomic_uint_fast64_t timeouts;
+  atomic_uint_fast64_t busy_polls;
+  atomic_uint_fast64_t commands;
+  struct stats_hist    dispatch_delay;
+  struct stats_hist    handler_time;
+};
+
+static atomic_uint_fast64_t _stats_seq;
+
+/// Poller shard served by the current poll or worker thread.
+static __thread struct iwn_poller *_thread_poller;
+
+IW_INLINE int64_t _time_ms(void) {
   struct timespec t;
-#if defined(__linux__)
-  clock_gettime(CLOCK_MONOTONIC_COARSE, &t);
-#elif defined(__APPLE__)
   clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+IW_INLINE int64_t _time_us(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+IW_INLINE bool _stats_enabled(const struct iwn_poller *p) {
+  return p->flags & IWN_POLLER_STATS;
+}
+
+/// Returns statistics block of the current thread for the given poller shard.
+static struct stats_block* _stats_block(struct iwn_poller *p) {
+  static __thread struct stats_block *tl_block;
+  static __thread uint64_t tl_stats_id;
+  if (IW_LIKELY(tl_stats_id == p->stats_id)) {
+    return tl_block;
+  }
+  pthread_t self = pthread_self();
+  struct stats_block *b = atomic_load(&p->stats);
+  for ( ; b && !pthread_equal(b->thread, self); b = b->next);
+  if (!b) {
+    b = calloc(1, sizeof(*b));
+    if (!b) {
+      return 0;
+    }
+    b->thread = self;
+    b->next = atomic_load(&p->stats);
+    while (!atomic_compare_exchange_weak(&p->stats, &b->next, b));
+  }
+  tl_block = b;
+  tl_stats_id = p->stats_id;
+  return b;
+}
+
+/// Increments statistics counter owned by the current thread.
+IW_INLINE void _stats_add(atomic_uint_fast64_t *c, uint64_t v) {
+  atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static void _stats_hist_add(struct stats_hist *h, int64_t v) {
+  if (v < 0) {
+    v = 0;
+  }
+  int idx = 63 - __builtin_clzll((uint64_t) v | 1);
+  if (idx >= IWN_POLLER_HISTOGRAM_BUCKETS) {
+    idx = IWN_POLLER_HISTOGRAM_BUCKETS - 1;
+  }
+  _stats_add(&h->count, 1);
+  _stats_add(&h->sum, v);
+  _stats_add(&h->buckets[idx], 1);
+  if ((uint64_t) v > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+    atomic_store_explicit(&h->max, v, memory_order_relaxed);
+  }
+}
+
+#define STATS_ADD(p__, field__, v__)                    \
+  do {                                                  \
+    if (IW_UNLIKELY(_stats_enabled(p__))) {             \
+      struct stats_block *b__ = _stats_block(p__);      \
+      if (b__) {                                        \
+        _stats_add(&b__->field__, (v__));               \
+      }                                                 \
+    }                                                   \
+  } while (0)
+
+/// Returns a poller shard serving the given `fd` or timer handle.
+IW_INLINE struct iwn_poller* _poller_shard(struct iwn_poller *p, int fd) {
+  p = p->root;
+  if (p->num_shards) {
+    return p->shards[(fd < 0 ? (unsigned) (-2 - fd) : (unsigned) fd) % p->num_shards];
+  }
+  return p;
+}
+
+/// Returns true if any of poller shards has user managed fds.
+static bool _poller_has_fds(struct iwn_poller *p) {
+  p = p->root;
+  if (p->num_shards) {
+    for (int i = 0; i < p->num_shards; ++i) {
+      if (p->shards[i]->fds_count > SERVICE_FDS) {
+        return true;
+      }
+    }
+    return false;
+  }
+  return p->fds_count > SERVICE_FDS;
+}
+
+static void _poller_poke(struct iwn_poller *p);
+static bool _cmd_submit(struct iwn_poller *p, struct poller_slot *s, uint32_t op, uint32_t events);
+static void _cmd_drain(struct iwn_poller *p);
+
+static void _poller_shutdown(struct iwn_poller *p) {
+  if (__sync_bool_compare_and_swap(&p->stop, false, true)) {
+    _poller_poke(p);
+  }
+}
+
+/// Shutdowns poller if it has no managed fds and IWN_POLLER_POLL_NO_FDS is not set.
+static void _poller_fds_check(struct iwn_poller *p) {
+  if (!(p->root->flags & IWN_POLLER_POLL_NO_FDS) && !_poller_has_fds(p)) {
+    iwn_poller_shutdown_request(p);
+  }
+}
+
+/// Packs poll events into 16 bits of slot state word.
+IW_INLINE uint64_t _events_pack(uint32_t events) {
+#if defined(IWN_EPOLL)
+  return (events & 0x3fffU) | ((events & EPOLLONESHOT) ? 0x4000U : 0) | ((events & EPOLLET) ? 0x8000U : 0);
 #else
-  clock_gettime(CLOCK_MONOTONIC_FAST, &t);
+  return events & SLOT_EVENTS_MASK;
 #endif
-  return t.tv_sec;
+}
+
+IW_INLINE uint32_t _events_unpack(uint64_t events) {
+#if defined(IWN_EPOLL)
+  return (events & 0x3fffU) | ((events & 0x4000U) ? EPOLLONESHOT : 0) | ((events & 0x8000U) ? EPOLLET : 0);
+#else
+  return events & SLOT_EVENTS_MASK;
+#endif
+}
+
+/// Returns slot directory and index within it for the given `fd`.
+static _Atomic(struct slots_dir*)* _slots_dir(struct iwn_poller *p, int fd, uint32_t *out_idx) {
+  if (fd < 0) {
+    if (fd == -1) {
+      return 0;
+    }
+    *out_idx = (uint32_t) (-2 - fd) / (uint32_t) MAX(1, p->root->num_shards);
+    return &p->tslots;
+  }
+  *out_idx = fd;
+  return &p->slots;
+}
+
+/// Returns slot for the given `fd` or zero if `fd` is out of allocated slot chunks.
+static struct poller_slot* _slot_at(struct iwn_poller *p, int fd) {
+  uint32_t idx;
+  _Atomic(struct slots_dir*) *dp = _slots_dir(p, fd, &idx);
+  if (!dp) {
+    return 0;
+  }
+  struct slots_dir *d = atomic_load_explicit(dp, memory_order_acquire);
+  uint32_t ci = idx >> SLOTS_CHUNK_BITS;
+  if (!d || ci >= d->num) {
+    return 0;
+  }
+  struct poller_slot *c = atomic_load_explicit(&d->chunks[ci], memory_order_acquire);
+  return c ? &c[idx & (SLOTS_CHUNK_SIZE - 1)] : 0;
+}
+
+/// Returns slot for the given `fd` allocating slots chunk if needed.
+static struct poller_slot* _slot_ensure(struct iwn_poller *p, int fd) {
+  uint32_t idx;
+  struct poller_slot *c, *s = _slot_at(p, fd);
+  if (s) {
+    return s;
+  }
+  _Atomic(struct slots_dir*) *dp = _slots_dir(p, fd, &idx);
+  if (!dp) {
+    errno = EINVAL;
+    return 0;
+  }
+  uint32_t ci = idx >> SLOTS_CHUNK_BITS;
+
+  pthread_mutex_lock(&p->mtx);
+  struct slots_dir *d = atomic_load_explicit(dp, memory_order_relaxed);
+  if (!d || ci >= d->num) {
+    uint32_t num = d ? d->num * 2 : 16;
+    if (num <= ci) {
+      num = ci + 1;
+    }
+    struct slots_dir *nd = calloc(1, sizeof(*nd) + num * sizeof(nd->chunks[0]));
+    if (!nd) {
+      goto finish;
+    }
+    nd->num = num;
+    nd->retired = d;
+    for (uint32_t i = 0; d && i < d->num; ++i) {
+      atomic_init(&nd->chunks[i], atomic_load_explicit(&d->chunks[i], memory_order_relaxed));
+    }
+    atomic_store_explicit(dp, nd, memory_order_release);
+    d = nd;
+  }
+  c = atomic_load_explicit(&d->chunks[ci], memory_order_relaxed);
+  if (!c) {
+    c = calloc(SLOTS_CHUNK_SIZE, sizeof(*c));
+    if (!c) {
+      goto finish;
+    }
+    atomic_store_explicit(&d->chunks[ci], c, memory_order_release);
+  }
+  s = &c[idx & (SLOTS_CHUNK_SIZE - 1)];
+
+finish:
+  pthread_mutex_unlock(&p->mtx);
+  return s;
+}
+
+static void _slots_dir_destroy(struct slots_dir *d) {
+  if (!d) {
+    return;
+  }
+  for (uint32_t i = 0; i < d->num; ++i) {
+    free(atomic_load_explicit(&d->chunks[i], memory_order_relaxed));
+  }
+  while (d) {
+    struct slots_dir *r = d->retired;
+    free(d);
+    d = r;
+  }
+}
+
+/// Calls `visitor` for every active slot of the given poller.
+static void _slots_visit(struct iwn_poller *p, void (*visitor)(struct poller_slot*, void*), void *op) {
+  _Atomic(struct slots_dir*) *dirs[] = {
+    &p->slots,
+    &p->tslots,
+  };
+  for (int i = 0; i < sizeof(dirs) / sizeof(dirs[0]); ++i) {
+    struct slots_dir *d = atomic_load_explicit(dirs[i], memory_order_acquire);
+    for (uint32_t ci = 0; d && ci < d->num; ++ci) {
+      struct poller_slot *c = atomic_load_explicit(&d->chunks[ci], memory_order_acquire);
+      for (uint32_t j = 0; c && j < SLOTS_CHUNK_SIZE; ++j) {
+        if (atomic_load_explicit(&c[j].state, memory_order_acquire) & SLOT_ACTIVE) {
+          visitor(&c[j], op);
+        }
+      }
+    }
+  }
+}
+
+/// Returns epoll/kqueue user data of slot.
+IW_INLINE uint64_t _slot_data(const struct poller_slot *s) {
+  return ((uint64_t) s->gen << 32) | (uint32_t) s->fd;
+}
+
+static void _wheel_init(struct wheel *w) {
+  w->now = _time_ms();
+  w->armed = INT64_MAX;
+}
+
+/// Links unlinked node `n` to the wheel bucket of the given time.
+/// Times not after the wheel time expire on the next wheel tick.
+static void _wheel_link(struct wheel *w, struct wheel_node *n, int64_t at) {
+  int64_t delta = at - w->now;
+  if (delta < 1) {
+    delta = 1;
+  } else if (delta >= (1LL << (WHEEL_BITS * WHEEL_LEVELS))) {
+    delta = (1LL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+  }
+  at = w->now + delta;
+  int level = (63 - __builtin_clzll((uint64_t) delta)) / WHEEL_BITS;
+  uint32_t idx = (at >> (level * WHEEL_BITS)) & WHEEL_MASK;
+  uint32_t bucket = level * WHEEL_SIZE + idx;
+
+  n->bucket = bucket;
+  n->prev = 0;
+  n->next = w->buckets[bucket];
+  if (n->next) {
+    n->next->prev = n;
+  }
+  w->buckets[bucket] = n;
+  w->occupied[level] |= 1ULL << idx;
+  atomic_store(&n->expire, at);
+}
+
+static void _wheel_unlink(struct wheel *w, struct wheel_node *n) {
+  uint32_t bucket = n->bucket;
+  if (n->prev) {
+    n->prev->next = n->next;
+  } else {
+    w->buckets[bucket] = n->next;
+    if (!n->next) {
+      w->occupied[bucket / WHEEL_SIZE] &= ~(1ULL << (bucket & WHEEL_MASK));
+    }
+  }
+  if (n->next) {
+    n->next->prev = n->prev;
+  }
+  n->next = n->prev = 0;
+  atomic_store(&n->expire, 0);
+}
+
+/// Returns the nearest time after the wheel time when some wheel bucket
+/// has to be processed or INT64_MAX if wheel is empty.
+static int64_t _wheel_next(const struct wheel *w) {
+  int64_t ret = INT64_MAX;
+  for (int level = 0; level < WHEEL_LEVELS; ++level) {
+    uint64_t bits = w->occupied[level];
+    if (!bits) {
+      continue;
+    }
+    int shift = level * WHEEL_BITS;
+    uint32_t r = ((w->now >> shift) + 1) & WHEEL_MASK;
+    if (r) { // Rotate bitmap so the bucket next to the current one is at zero bit
+      bits = (bits >> r) | (bits << (WHEEL_SIZE - r));
+    }
+    int64_t d = __builtin_ctzll(bits) + 1;
+    int64_t at = level ? ((w->now >> shift) + d) << shift : w->now + d;
+    if (at < ret) {
+      ret = at;
+    }
+  }
+  return ret;
+}
+
+/// Moves wheel time forward to `now`. Expired nodes are unlinked and pushed to `due` list.
+static void _wheel_advance(struct wheel *w, int64_t now, struct wheel_node **due) {
+  while (1) {
+    int64_t at = _wheel_next(w);
+    if (at > now) {
+      if (now > w->now) {
+        w->now = now;
+      }
+      break;
+    }
+    w->now = at;
+    // Cascade higher level buckets starting at this time, then expire level zero bucket
+    for (int level = WHEEL_LEVELS - 1; level >= 0; --level) {
+      int shift = level * WHEEL_BITS;
+      if (at & ((1LL << shift) - 1)) {
+        continue;
+      }
+      uint32_t idx = (at >> shift) & WHEEL_MASK;
+      uint32_t bucket = level * WHEEL_SIZE + idx;
+      struct wheel_node *n = w->buckets[bucket];
+      w->buckets[bucket] = 0;
+      w->occupied[level] &= ~(1ULL << idx);
+      while (n) {
+        struct wheel_node *next = n->next;
+        int64_t expire = atomic_load_explicit(&n->expire, memory_order_relaxed);
+        if (expire > at) {
+          _wheel_link(w, n, expire);
+        } else {
+          n->prev = 0;
+          n->next = *due;
+          *due = n;
+          atomic_store(&n->expire, 0);
+        }
+        n = next;
+      }
+    }
+  }
+}
+
+/// Acquires a handle for timer task on the given poller shard.
+/// Timer handles are negative numbers less than -1 so they never clash with file descriptors.
+/// Returns zero if handles are exhausted.
+static int _timer_handle_acquire(struct iwn_poller *p) {
+  int ret = 0;
+  uint32_t idx, n = MAX(1, p->root->num_shards);
+  pthread_mutex_lock(&p->mtx);
+  if (p->tfree_num) {
+    idx = p->tfree[--p->tfree_num];
+  } else if (p->tnext < (INT_MAX - 2) / n) {
+    idx = p->tnext++;
+  } else {
+    goto finish;
+  }
+  ret = -2 - (int) (idx * n + p->idx);
+
+finish:
+  pthread_mutex_unlock(&p->mtx);
+  return ret;
+}
+
+static void _timer_handle_release(struct iwn_poller *p, int h) {
+  uint32_t n = MAX(1, p->root->num_shards);
+  pthread_mutex_lock(&p->mtx);
+  if (p->tfree_num == p->tfree_cap) {
+    uint32_t cap = p->tfree_cap ? p->tfree_cap * 2 : 64;
+    uint32_t *tfree = realloc(p->tfree, cap * sizeof(*tfree));
+    if (!tfree) { // Handle is lost
+      goto finish;
+    }
+    p->tfree = tfree;
+    p->tfree_cap = cap;
+  }
+  p->tfree[p->tfree_num++] = (uint32_t) (-2 - h) / n;
+
+finish:
+  pthread_mutex_unlock(&p->mtx);
 }
 
 static void _slot_destroy(struct poller_slot *s) {
-  if (__sync_bool_compare_and_swap(&s->destroy_cas, false, true)) {  // Avoid recursion
-    if (s->on_dispose) {
-      s->on_dispose((void*) s);
+  int fd = s->fd;
+  struct iwn_poller *p = s->poller;
+  if (s->on_dispose) {
+    s->on_dispose((void*) s);
+  }
+  atomic_store_explicit(&s->timeout_limit, INT64_MAX, memory_order_relaxed);
+  // Slot is free to use from now, fd number cannot be reused by anybody until close()
+  atomic_store_explicit(&s->state, 0, memory_order_release);
+  if (fd > -1) {
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+  } else {
+    _timer_handle_release(p, fd);
+  }
+}
+
+#if defined(IWN_URING)
+
+#define URING_ENTRIES 2048
+#define URING_WAKEUP  UINT64_MAX ///< User data of wakeup eventfd poll request
+
+/// io_uring submission and completion rings of poller shard.
+/// Edge triggered slots are polled by multishot IORING_OP_POLL_ADD requests for both directions
+/// and their ready events are tracked in user space, so slot rearm doesn't need any request.
+/// Other slots are polled by oneshot requests, slot rearm is a new poll request.
+/// Requests are submitted only by the poll thread in batch by its next io_uring_enter() call,
+/// if the poll thread is waiting for completions it is woken up by `wfd` eventfd.
+/// Submitting requests from the poll thread is essential since completions of poll requests
+/// are run in the context of the submitter task.
+struct uring {
+  int fd;
+  int wfd;               ///< Wakeup eventfd polled by multishot poll request
+  unsigned  sq_entries;
+  unsigned  sq_mask;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned  cq_mask;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  struct io_uring_cqe *cqes;
+  void  *sq_ring;
+  void  *cq_ring;
+  size_t sq_ring_size;
+  size_t cq_ring_size;
+  size_t sqes_size;
+  uint8_t     sqe_flags; ///< Flags of poll remove requests
+  atomic_bool waiting;   ///< Poll thread is blocked in io_uring_enter()
+  pthread_mutex_t mtx;   ///< Guards submission queue
+};
+
+IW_INLINE int _uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, 0, 0);
+}
+
+static void _uring_destroy(struct uring *u) {
+  if (!u) {
+    return;
+  }
+  if (u->sqes && u->sqes != MAP_FAILED) {
+    munmap(u->sqes, u->sqes_size);
+  }
+  if (u->cq_ring && u->cq_ring != MAP_FAILED && u->cq_ring != u->sq_ring) {
+    munmap(u->cq_ring, u->cq_ring_size);
+  }
+  if (u->sq_ring && u->sq_ring != MAP_FAILED) {
+    munmap(u->sq_ring, u->sq_ring_size);
+  }
+  if (u->wfd > -1) {
+    close(u->wfd);
+  }
+  pthread_mutex_destroy(&u->mtx);
+  free(u);
+}
+
+IW_INLINE uint32_t _uring_poll_mask(uint32_t events) {
+  events &= ~(EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  events = (events << 16) | (events >> 16);
+#endif
+  return events;
+}
+
+/// Returns zeroed submission queue entry or zero on error.
+/// If submission queue is full pending entries are submitted by the caller.
+/// Caller must hold `u->mtx`.
+static struct io_uring_sqe* _uring_sqe_lk(struct uring *u) {
+  unsigned tail = *u->sq_tail;
+  while (tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+    if (_uring_enter(u->fd, u->sq_entries, 0, 0) == -1 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      return 0;
     }
-    if (s->fd > -1) {
-      shutdown(s->fd, SHUT_RDWR);
-      close(s->fd);
+  }
+  unsigned idx = tail & u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  u->sq_array[idx] = idx;
+  return sqe;
+}
+
+/// Publishes submission queue entry obtained by `_uring_sqe_lk()`.
+/// Entries are submitted by the poll thread, it is woken up if waiting for completions.
+static int _uring_commit_lk(struct uring *u) {
+  __atomic_store_n(u->sq_tail, *u->sq_tail + 1, __ATOMIC_SEQ_CST);
+  if (atomic_exchange(&u->waiting, false)) {
+    uint64_t val = 1;
+    while (write(u->wfd, &val, sizeof(val)) == -1) {
+      if (errno != EINTR) {
+        return errno == EAGAIN ? 0 : -1;
+      }
     }
-    free(s);
   }
+  return 0;
+}
+
+/// Queues multishot poll request of wakeup eventfd.
+static void _uring_wakeup_arm(struct uring *u) {
+  pthread_mutex_lock(&u->mtx);
+  struct io_uring_sqe *sqe = _uring_sqe_lk(u);
+  if (sqe) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = u->wfd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = URING_WAKEUP;
+    sqe->poll32_events = _uring_poll_mask(EPOLLIN);
+    _uring_commit_lk(u);
+  }
+  pthread_mutex_unlock(&u->mtx);
 }
 
+/// Creates io_uring instance. Caller owns the ring fd.
+static iwrc _uring_create(struct uring **out) {
+  iwrc rc = 0;
+  struct io_uring_params params = { 0 };
+  struct uring *u = calloc(1, sizeof(*u));
+  if (!u) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  u->fd = -1;
+  u->wfd = -1;
+  RCN(finish, pthread_mutex_init(&u->mtx, 0));
+
+  u->fd = (int) syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+  RCN(finish, u->fd);
+  if (  !(params.features & IORING_FEAT_SINGLE_MMAP)
+     || !(params.features & IORING_FEAT_NODROP)
+     || !(params.features & IORING_FEAT_RSRC_TAGS)) { // Multishot poll requests need Linux 5.13+
+    rc = IW_ERROR_UNSUPPORTED;
+    goto finish;
+  }
+  if (params.features & IORING_FEAT_CQE_SKIP) {
+    u->sqe_flags = IOSQE_CQE_SKIP_SUCCESS;
+  }
+
+  u->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  u->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (u->cq_ring_size > u->sq_ring_size) {
+    u->sq_ring_size = u->cq_ring_size;
+  }
+  u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  u->sq_ring = mmap(0, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    u->fd, IORING_OFF_SQ_RING);
+  if (u->sq_ring == MAP_FAILED) {
+    rc = iwrc_set_errno(IW_ERROR_ERRNO, errno);
+    goto finish;
+  }
+  u->cq_ring = u->sq_ring;
+  u->sqes = mmap(0, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 u->fd, IORING_OFF_SQES);
+  if (u->sqes == MAP_FAILED) {
+    rc = iwrc_set_errno(IW_ERROR_ERRNO, errno);
+    goto finish;
+  }
+
+  u->sq_entries = params.sq_entries;
+  u->sq_head = (void*) ((char*) u->sq_ring + params.sq_off.head);
+  u->sq_tail = (void*) ((char*) u->sq_ring + params.sq_off.tail);
+  u->sq_mask = *(unsigned*) ((char*) u->sq_ring + params.sq_off.ring_mask);
+  u->sq_array = (void*) ((char*) u->sq_ring + params.sq_off.array);
+  u->cq_head = (void*) ((char*) u->cq_ring + params.cq_off.head);
+  u->cq_tail = (void*) ((char*) u->cq_ring + params.cq_off.tail);
+  u->cq_mask = *(unsigned*) ((char*) u->cq_ring + params.cq_off.ring_mask);
+  u->cqes = (void*) ((char*) u->cq_ring + params.cq_off.cqes);
+
+  u->wfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  RCN(finish, u->wfd);
+  _uring_wakeup_arm(u); // Submitted by the first io_uring_enter() of poll thread
+
+finish:
+  if (rc) {
+    if (u->fd > -1) {
+      close(u->fd);
+    }
+    _uring_destroy(u);
+  } else {
+    *out = u;
+  }
+  return rc;
+}
+
+IW_INLINE uint64_t _uring_poll_data(const struct poller_slot *s) {
+  return _slot_data(s) | ((uint64_t) s->poll_epoch << 32);
+}
+
+/// Queues removal of pending poll request of the slot. Caller must hold `u->mtx`.
+static int _uring_poll_remove_lk(struct uring *u, struct poller_slot *s) {
+  struct io_uring_sqe *sqe = _uring_sqe_lk(u);
+  if (!sqe) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->flags = u->sqe_flags;
+  sqe->fd = -1;
+  sqe->addr = _uring_poll_data(s);
+  return 0;
+}
+
+/// Adds poll request for the slot fd, multishot one for edge triggered `events`.
+/// Pending poll request with other events is replaced by the new one.
+/// Poll update requests (IORING_POLL_UPDATE_EVENTS) are not used since they
+/// may lose completion of fd being ready at the time of update.
+static int _uring_poll_arm(struct poller_slot *s, uint32_t events) {
+  int rci = -1;
+  struct uring *u = s->poller->uring;
+  uint32_t mask = _uring_poll_mask(events);
+  pthread_mutex_lock(&u->mtx);
+  if (atomic_load(&s->state) & SLOT_UNSUBSCRIBED) {
+    rci = 0;
+    goto finish;
+  }
+  uint32_t pending = atomic_exchange(&s->polling, mask);
+  if (pending == mask) {
+    rci = 0;
+    goto finish;
+  }
+  if (pending) {
+    // Completion of the replaced request is ignored since its epoch doesn't match
+    if (_uring_poll_remove_lk(u, s) == -1) {
+      goto finish;
+    }
+  }
+  s->poll_epoch ^= 1;
+  struct io_uring_sqe *sqe = _uring_sqe_lk(u);
+  if (!sqe) {
+    goto finish;
+  }
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = s->fd;
+  sqe->user_data = _uring_poll_data(s);
+  sqe->poll32_events = mask;
+  if (events & EPOLLET) {
+    sqe->len = IORING_POLL_ADD_MULTI;
+  }
+  rci = _uring_commit_lk(u);
+
+finish:
+  pthread_mutex_unlock(&u->mtx);
+  return rci;
+}
+
+/// Handles completion of the slot poll request having given `epoch`.
+/// Returns false if completion belongs to the replaced request.
+static bool _uring_poll_done(struct poller_slot *s, uint32_t epoch, bool more) {
+  bool ret = true;
+  struct uring *u = s->poller->uring;
+  pthread_mutex_lock(&u->mtx);
+  if (epoch != s->poll_epoch) {
+    ret = false;
+  } else if (!more) {
+    atomic_store(&s->polling, 0);
+  }
+  pthread_mutex_unlock(&u->mtx);
+  return ret;
+}
+
+/// Cancels pending poll request of the slot.
+static void _uring_poll_remove(struct poller_slot *s) {
+  struct uring *u = s->poller->uring;
+  pthread_mutex_lock(&u->mtx);
+  if (atomic_exchange(&s->polling, 0) && _uring_poll_remove_lk(u, s) == 0) {
+    _uring_commit_lk(u);
+  }
+  pthread_mutex_unlock(&u->mtx);
+}
+
+#endif
+
+#if defined(IWN_EPOLL)
+
+/// Events edge triggered slot fd is persistently polled for.
+#define SLOT_EDGE_EVENTS (EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP | EPOLLET)
+
+#define EDGE_READY_MASK 0xffffU  ///< Ready events bits of `poller_slot::edge`
+#define EDGE_TICK_SHIFT 16       ///< Tick bumped on every ready events received from the kernel
+
+/// Updates state of edge triggered slot by `ready` events received from the kernel
+/// or by a new `interest` events mask if `rearm` is set.
+/// Returns ready events slot is interested in, slot interest is reset until the next rearm.
+/// Ready events of IWN_POLLPERSIST slot are kept until iwn_poller_edge_drained() is called,
+/// so these are dispatched again on rearm if the handler did not exhaust them.
+/// Ready events of other slots are taken from the state once dispatched.
+static uint32_t _slot_edge_update(struct poller_slot *s, uint32_t ready, uint32_t interest, bool rearm) {
+  uint32_t ret;
+  bool keep = s->events_mod & IWN_POLLPERSIST;
+  uint64_t nst, st = atomic_load_explicit(&s->edge, memory_order_relaxed);
+  do {
+    uint32_t r = (uint32_t) st;
+    if (ready) {
+      r = (r | (ready & EDGE_READY_MASK)) + (1U << EDGE_TICK_SHIFT);
+    }
+    uint32_t i = rearm ? interest : (uint32_t) (st >> 32);
+    ret = r & i & EDGE_READY_MASK;
+    if (ret) {
+      if (!keep) {
+        r &= ~ret;
+      }
+      i = 0;
+    }
+    nst = ((uint64_t) i << 32) | r;
+  } while (!atomic_compare_exchange_weak_explicit(&s->edge, &st, nst,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+  if (ret && keep) {
+    atomic_store_explicit(&s->edge_tick, (uint32_t) nst >> EDGE_TICK_SHIFT, memory_order_relaxed);
+  }
+  return ret;
+}
+
+#endif
+
 #ifdef IWN_KQUEUE
 
 IW_INLINE unsigned short _events_to_kflags(uint32_t events) {
@@ -124,8 +992,7 @@ IW_INLINE unsigned short _events_to_kflags(uint32_t events) {
 }
 
 IW_INLINE void _rw_fd_unsubscribe(struct poller_slot *s) {
-  if (!(s->flags & SLOT_UNSUBSCRIBED)) {
-    s->flags |= SLOT_UNSUBSCRIBED;
+  if (s->fd > -1 && !(atomic_fetch_or(&s->state, SLOT_UNSUBSCRIBED) & SLOT_UNSUBSCRIBED)) {
     struct kevent ev[] = {
       { s->fd, EVFILT_READ,  EV_DELETE },
       { s->fd, EVFILT_WRITE, EV_DELETE },
@@ -146,173 +1013,176 @@ IW_INLINE void _service_fds_unsubcribe(struct iwn_poller *p) {
 #else
 
 IW_INLINE void _rw_fd_unsubscribe(struct poller_slot *s) {
-  if (!(s->flags & SLOT_UNSUBSCRIBED)) {
-    s->flags |= SLOT_UNSUBSCRIBED;
+  if (s->fd > -1 && !(atomic_fetch_or(&s->state, SLOT_UNSUBSCRIBED) & SLOT_UNSUBSCRIBED)) {
+#if defined(IWN_URING)
+    if (s->poller->uring) {
+      _uring_poll_remove(s);
+      return;
+    }
+#endif
     epoll_ctl(s->poller->fd, EPOLL_CTL_DEL, s->fd, 0);
   }
 }
 
 #endif
 
-static bool _slot_unref(struct poller_slot *s, uint8_t flags) {
+/// Unsubscribes removed slot fd and updates poller fds counter.
+static void _slot_removed(struct poller_slot *s) {
   struct iwn_poller *p = s->poller;
-  if (!(flags & REF_LOCKED)) {
-    pthread_mutex_lock(&p->mtx);
-  }
-  if (s->flags & SLOT_REMOVED) {
-    pthread_mutex_unlock(&p->mtx);
-    return false;
-  }
-  --s->refs;
-  bool destroy = s->refs == 0;
-  if (destroy) {
-    s->flags |= SLOT_REMOVED;
-    _rw_fd_unsubscribe(s);
-    if (iwhmap_remove_u32(p->slots, s->fd)) {
-      --p->fds_count;
-#if defined(IWN_EPOLL)
-      if (p->fds_count < 3 && !(p->flags & IWN_POLLER_POLL_NO_FDS)) {
-#elif defined(IWN_KQUEUE)
-      if (p->fds_count < 1 && !(p->flags & IWN_POLLER_POLL_NO_FDS)) {
-#endif
-        iwn_poller_shutdown_request(p);
-      }
+  _rw_fd_unsubscribe(s);
+  --p->fds_count;
+  _poller_fds_check(p);
+}
+
+/// Releases slot reference. Returns true if it was the last reference and slot is removed.
+/// Removed slot is destroyed unless `REF_DESTROY_DEFER` flag is set.
+static bool _slot_unref(struct poller_slot *s, uint8_t flags) {
+  uint64_t nst, st = atomic_load_explicit(&s->state, memory_order_relaxed);
+  do {
+    if (st & SLOT_REMOVED) {
+      return false;
     }
+    nst = st - 1;
+    if ((st & SLOT_REFS_MASK) == 1) {
+      nst |= SLOT_REMOVED;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, nst,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+  if (!(nst & SLOT_REMOVED)) {
+    return false;
   }
-  if (!(flags & (REF_SET_LOCKED | REF_LOCKED))) {
-    pthread_mutex_unlock(&p->mtx);
-  }
-  if (destroy && !(flags & (REF_DESTROY_DEFER | REF_SET_LOCKED | REF_LOCKED))) {
+  _slot_removed(s);
+  if (!(flags & REF_DESTROY_DEFER)) {
     _slot_destroy(s);
   }
-  return destroy;
+  return true;
 }
 
-static iwrc _slot_ref(struct poller_slot *s) {
-  iwrc rc = 0;
-  struct iwn_poller *p = s->poller;
-  pthread_mutex_lock(&p->mtx);
-  if (++s->refs == 1) {
-    struct poller_slot *os = iwhmap_get_u32(p->slots, s->fd);
-    if (os) {
-      pthread_mutex_unlock(&p->mtx);
-      iwlog_error("FD: %d is managed already, poller: %d", s->fd, p->fd);
-      return IW_ERROR_INVALID_STATE;
-    }
-    rc = iwhmap_put_u32(p->slots, s->fd, s);
-    if (!rc) {
-      ++p->fds_count;
+/// Acquires reference on active slot which is not pending to remove.
+static bool _slot_ref(struct poller_slot *s) {
+  uint64_t st = atomic_load_explicit(&s->state, memory_order_relaxed);
+  do {
+    if ((st & (SLOT_ACTIVE | SLOT_REMOVED | SLOT_REMOVE_PENDING)) != SLOT_ACTIVE) {
+      return false;
     }
-  }
-  pthread_mutex_unlock(&p->mtx);
-  return rc;
+  } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, st + 1,
+                                                  memory_order_acquire, memory_order_relaxed));
+  return true;
 }
 
-static struct poller_slot* _slot_ref_id(struct iwn_poller *p, int fd, uint8_t flags) {
-  struct poller_slot *s;
-  if (!(flags & REF_LOCKED)) {
-    pthread_mutex_lock(&p->mtx);
-  }
-  s = iwhmap_get_u32(p->slots, fd);
-  if (s) {
-    if (s->flags & (SLOT_REMOVED | SLOT_REMOVE_PENDING)) {
-      s = 0;
-    } else {
-      ++s->refs;
-    }
+/// Acquires reference on slot managing the given `fd`.
+/// If `gen` is not zero slot generation should match it.
+static struct poller_slot* _slot_ref_id(struct iwn_poller *p, int fd, uint32_t gen) {
+  struct poller_slot *s = _slot_at(p, fd);
+  if (!s || !_slot_ref(s)) {
+    return 0;
   }
-  if (!(flags & (REF_SET_LOCKED | REF_LOCKED))) {
-    pthread_mutex_unlock(&p->mtx);
+  if (gen && s->gen != (gen & ~1U)) { // Stale event for the previous owner of fd
+    _slot_unref(s, 0);
+    return 0;
   }
   return s;
 }
 
-IW_INLINE struct poller_slot* _slot_peek_leave_locked(struct iwn_poller *p, int fd) {
-  pthread_mutex_lock(&p->mtx);
-  return iwhmap_get_u32(p->slots, fd);
+/// Marks slot as pending to remove and releases caller's reference
+/// along with slot's own one.
+static void _slot_remove_unref(struct poller_slot *s) {
+  if (!(atomic_fetch_or(&s->state, SLOT_REMOVE_PENDING) & SLOT_REMOVE_PENDING)) {
+    _rw_fd_unsubscribe(s);
+    _slot_unref(s, 0);
+  }
+  _slot_unref(s, 0);
 }
 
-static void _slot_remove_unref(struct iwn_poller *p, int fd) {
-  struct poller_slot *s = _slot_peek_leave_locked(p, fd);
-  if (!s || (s->flags & (SLOT_REMOVE_PENDING | SLOT_REMOVED))) {
-    pthread_mutex_unlock(&p->mtx);
-    return;
-  }
-  s->flags |= SLOT_REMOVE_PENDING;
-  bool destroy = _slot_unref(s, REF_LOCKED);
-  if (!destroy) {
-    destroy = _slot_unref(s, REF_LOCKED);
-  }
-  pthread_mutex_unlock(&p->mtx);
-  if (destroy) {
-    _slot_destroy(s);
-  }
-  return;
+static void _poller_remove(struct iwn_poller *p, int fd) {
+  struct poller_slot *s = _slot_at(p, fd);
+  uint64_t st = s ? atomic_load_explicit(&s->state, memory_order_relaxed) : 0;
+  do {
+    if (!(st & SLOT_ACTIVE)) {
+      if (fd > -1) {
+        close(fd);
+      }
+      return;
+    }
+    if (st & (SLOT_REMOVE_PENDING | SLOT_REMOVED)) {
+      return;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, st | SLOT_REMOVE_PENDING,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+  _rw_fd_unsubscribe(s);
+  _slot_unref(s, 0);
 }
 
 void iwn_poller_remove(struct iwn_poller *p, int fd) {
-  if (!p) {
-    return;
-  }
-  struct poller_slot *s = _slot_peek_leave_locked(p, fd);
-  if (!s) {
-    pthread_mutex_unlock(&p->mtx);
-    if (fd > -1) {
-      close(fd);
+  if (p) {
+    p = _poller_shard(p, fd);
+    if (p->cmdq) {
+      struct poller_slot *s = _slot_ref_id(p, fd, 0);
+      if (s) {
+        bool submitted = _cmd_submit(p, s, CMD_REMOVE, 0);
+        _slot_unref(s, 0);
+        if (submitted) {
+          return;
+        }
+      }
     }
-    return;
-  }
-  if (s->flags & SLOT_REMOVE_PENDING) {
-    pthread_mutex_unlock(&p->mtx);
-    return;
-  }
-  s->flags |= SLOT_REMOVE_PENDING;
-  _rw_fd_unsubscribe(s);
-  bool destroy = _slot_unref(s, REF_LOCKED);
-  pthread_mutex_unlock(&p->mtx);
-  if (destroy) {
-    _slot_destroy(s);
+    _poller_remove(p, fd);
   }
 }
 
+static void _poller_cleanup_visitor(struct poller_slot *s, void *op) {
+  _poller_remove(op, s->fd);
+}
+
 static void _poller_cleanup(struct iwn_poller *p) {
-  int *fds, i;
-  int buf[1024];
-  IWHMAP_ITER iter;
+  _cmd_drain(p);
+  _slots_visit(p, _poller_cleanup_visitor, p);
+}
 
-  pthread_mutex_lock(&p->mtx);
-  uint32_t sz = iwhmap_count(p->slots);
-  if (sz <= sizeof(buf) / sizeof(buf[0])) {
-    fds = buf;
-  } else {
-    fds = calloc(sz, sizeof(*fds));
-    if (!fds) {
-      pthread_mutex_unlock(&p->mtx);
-      return;
-    }
+/// Waits for completion of all tasks scheduled to poller worker threads and stops them.
+static void _poller_workers_shutdown(struct iwn_poller *p) {
+  if (p->wstp) {
+    iwn_wstp_shutdown(&p->wstp, true);
+  } else if (p->tp) {
+    iwtp_shutdown(&p->tp, true);
   }
-  iwhmap_iter_init(p->slots, &iter);
-  for (i = 0; iwhmap_iter_next(&iter); ++i) {
-    fds[i] = (int) (intptr_t) iter.key;
+  if (p->tp_prio) {
+    iwtp_shutdown(&p->tp_prio, true);
   }
-  pthread_mutex_unlock(&p->mtx);
-
-  while (--i >= 0) {
-    iwn_poller_remove(p, fds[i]);
-  }
-
-  if (fds != buf) {
-    free(fds);
+  if (p->tp_bg) {
+    iwtp_shutdown(&p->tp_bg, true);
   }
 }
 
 static void _destroy(struct iwn_poller *p) {
   if (p) {
-    iwn_poller_shutdown_request(p);
-    iwtp_shutdown(&p->tp, true);
+    if (p->shards) { // Root of sharded poller
+      iwn_poller_shutdown_request(p);
+      // Shards are linked with each other through the root,
+      // so all of them should be stopped and cleaned before any is disposed.
+      for (int i = 0; i < p->num_shards; ++i) {
+        _poller_workers_shutdown(p->shards[i]);
+      }
+      for (int i = 0; i < p->num_shards; ++i) {
+        _poller_cleanup(p->shards[i]);
+      }
+      for (int i = 0; i < p->num_shards; ++i) {
+        _destroy(p->shards[i]);
+      }
+      free(p->shards);
+      free(p->thread_name);
+      pthread_mutex_destroy(&p->mtx);
+      free(p);
+      return;
+    }
+    _poller_shutdown(p);
+    _poller_workers_shutdown(p);
     _poller_cleanup(p);
 
 #if defined(IWN_EPOLL)
+#if defined(IWN_URING)
+    _uring_destroy(p->uring);
+#endif
     if (p->fd > -1) {
       close(p->fd);
     }
@@ -326,240 +1196,540 @@ static void _destroy(struct iwn_poller *p) {
     _service_fds_unsubcribe(p);
 #endif
 
-    iwhmap_destroy(p->slots);
-    pthread_mutex_destroy(&p->mtx);
-    free(p);
+    _slots_dir_destroy(atomic_load(&p->slots));
+    _slots_dir_destroy(atomic_load(&p->tslots));
+    free(p->tfree);
+    for (struct stats_block *b = atomic_load(&p->stats), *n; b; b = n) {
+      n = b->next;
+      free(b);
+    }
+#if defined(__linux__)
+    free(p->cpuset);
+#endif
+    free(p->cmdq);
+    pthread_mutex_destroy(&p->wheel.mtx);
+    pthread_mutex_destroy(&p->mtx);
+    free(p->thread_name);
+    free(p);
+  }
+}
+
+/// Arms poller timer at the given time in milliseconds, INT64_MAX disarms the timer.
+/// Caller must hold wheel lock.
+static void _timer_arm(struct iwn_poller *p, int64_t at) {
+  struct wheel *w = &p->wheel;
+  if (w->armed == at) {
+    return;
+  }
+  w->armed = at;
+#if defined(IWN_EPOLL)
+  if (p->timer_fd > -1) {
+    struct itimerspec ts = { 0 };
+    if (at != INT64_MAX) {
+      ts.it_value.tv_sec = at / 1000;
+      ts.it_value.tv_nsec = (at % 1000) * 1000000;
+    }
+    timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &ts, 0);
+  }
+#elif defined(IWN_KQUEUE)
+  struct kevent ev = {
+    .ident  = p->fd,
+    .filter = EVFILT_TIMER,
+  };
+  if (at == INT64_MAX) {
+    ev.flags = EV_DELETE;
+    kevent(p->fd, &ev, 1, 0, 0, 0);
+  } else {
+    int64_t now = _time_ms();
+    ev.flags = EV_ADD | EV_ENABLE | EV_ONESHOT;
+    ev.data = at > now ? at - now : 0;
+    if (kevent(p->fd, &ev, 1, 0, 0, 0) == -1) {
+      iwrc rc = iwrc_set_errno(IW_ERROR_ERRNO, errno);
+      iwlog_ecode_error3(rc);
+    }
+  }
+#endif
+}
+
+/// Returns wheel time for the given slot deadline.
+/// Inactivity deadlines are rounded up to coalesce timer wakeups.
+IW_INLINE int64_t _slot_wheel_time(const struct poller_slot *s, int64_t deadline) {
+  if (s->events & IWN_POLLTIMEOUT) {
+    return deadline;
+  }
+  return (deadline + WHEEL_SLACK_MASK) & ~WHEEL_SLACK_MASK;
+}
+
+/// Sets inactivity deadline of slot or firing time of timer task in milliseconds.
+/// In order to keep frequent deadline updates cheap the slot is relinked in timing wheel only if
+/// it is not in the wheel or its wheel time is after the new deadline. Otherwise slot
+/// is rescheduled when its wheel entry fires.
+static void _slot_deadline_set(struct poller_slot *s, int64_t deadline) {
+  atomic_store(&s->timeout_limit, deadline);
+  if (deadline == INT64_MAX) {
+    return;
+  }
+  deadline = _slot_wheel_time(s, deadline);
+  int64_t at = atomic_load(&s->tnode.expire);
+  if (at && at <= deadline) {
+    return;
+  }
+  struct iwn_poller *p = s->poller;
+  struct wheel *w = &p->wheel;
+  pthread_mutex_lock(&w->mtx);
+  at = atomic_load_explicit(&s->tnode.expire, memory_order_relaxed);
+  if (!at || at > deadline) {
+    if (at) {
+      _wheel_unlink(w, &s->tnode);
+    }
+    _wheel_link(w, &s->tnode, deadline);
+    at = atomic_load_explicit(&s->tnode.expire, memory_order_relaxed);
+    if (at < w->armed) {
+      _timer_arm(p, at);
+    }
+  }
+  pthread_mutex_unlock(&w->mtx);
+}
+
+static void _worker_fn(void *arg);
+static void _slot_dispatch(struct poller_slot *s, uint32_t events, bool abort, bool reactor);
+
+/// Returns dispatch priority lane of slot according to its IWN_POLLPRIO/IWN_POLLBACKGROUND flags.
+IW_INLINE int _slot_prio(const struct poller_slot *s) {
+  if (s->events_mod & IWN_POLLPRIO) {
+    return IWN_POLLER_PRIO_HIGH;
+  } else if (s->events_mod & IWN_POLLBACKGROUND) {
+    return IWN_POLLER_PRIO_BACKGROUND;
+  }
+  return IWN_POLLER_PRIO_NORMAL;
+}
+
+/// Schedules execution of `fn` by poller worker threads of the given priority lane.
+static iwrc _poller_schedule(struct iwn_poller *p, int prio, void (*fn)(void*), void *arg) {
+  if (prio == IWN_POLLER_PRIO_HIGH && p->tp_prio) {
+    return iwtp_schedule(p->tp_prio, fn, arg);
+  } else if (prio == IWN_POLLER_PRIO_BACKGROUND && p->tp_bg) {
+    return iwtp_schedule(p->tp_bg, fn, arg);
+  }
+  if (p->wstp) {
+    return iwn_wstp_schedule(p->wstp, fn, arg);
+  }
+  return iwtp_schedule(p->tp, fn, arg);
+}
+
+/// Schedules execution of timer task slot. Consumes caller's slot reference.
+static void _slot_fire(struct poller_slot *s) {
+  if (atomic_fetch_or(&s->state, SLOT_PROCESSING) & SLOT_PROCESSING) {
+    _slot_unref(s, 0);
+    return;
+  }
+  s->events_processing = IWN_POLLTIMEOUT;
+  s->dispatched_us = 0;
+  if (_poller_schedule(s->poller, _slot_prio(s), _worker_fn, s)) {
+    _slot_remove_unref(s);
+  }
+}
+
+static void _timer_ready_impl(struct iwn_poller *p) {
+  struct wheel *w = &p->wheel;
+  struct wheel_node *due = 0;
+  struct poller_slot *expired = 0;
+  int64_t now = _time_ms();
+
+  pthread_mutex_lock(&w->mtx);
+  w->armed = INT64_MAX;
+  _wheel_advance(w, now, &due);
+  while (due) {
+    struct wheel_node *n = due;
+    struct poller_slot *s = (void*) ((char*) n - offsetof(struct poller_slot, tnode));
+    due = n->next;
+    n->next = 0;
+    // Slot being processed is relinked when its processing is finished
+    if (atomic_load(&s->state) & SLOT_PROCESSING) {
+      continue;
+    }
+    int64_t deadline = atomic_load(&s->timeout_limit);
+    if (deadline == INT64_MAX) {
+      continue;
+    }
+    if (deadline > now) {
+      _wheel_link(w, n, _slot_wheel_time(s, deadline));
+    } else if (_slot_ref(s)) {
+      atomic_store(&s->timeout_limit, INT64_MAX);
+      s->next = expired;
+      expired = s;
+    }
+  }
+  _timer_arm(p, _wheel_next(w));
+  pthread_mutex_unlock(&w->mtx);
+
+  if (IW_UNLIKELY(_stats_enabled(p) && expired)) {
+    uint64_t n = 0;
+    for (struct poller_slot *e = expired; e; e = e->next, ++n);
+    STATS_ADD(p, timeouts, n);
+  }
+  while (expired) {
+    struct poller_slot *n = expired->next;
+    if (expired->events & IWN_POLLTIMEOUT) {
+      _slot_fire(expired);
+    } else {
+      _slot_remove_unref(expired);
+    }
+    expired = n;
+  }
+}
+
+#if defined(IWN_EPOLL)
+
+static int64_t _timer_ready_fd(const struct iwn_poller_task *t, uint32_t events) {
+  uint64_t buf;
+  while (read(t->fd, &buf, sizeof(buf)) != -1);
+  _timer_ready_impl(t->poller);
+  return 0;
+}
+
+#endif
+
+#if defined(IWN_EPOLL)
+
+/// Sets interest events of persistent edge triggered slot
+/// and dispatches them if they are ready already.
+/// Interest is replaced by the given `events`, previously armed events not listed here are dropped.
+static int _slot_edge_rearm(struct poller_slot *s, uint32_t events) {
+  events = _slot_edge_update(s, 0, events & ~(EPOLLET | EPOLLONESHOT | EPOLLEXCLUSIVE), true);
+  if (events && _slot_ref(s)) {
+    _slot_dispatch(s, events, false, false);
   }
+  return 0;
 }
 
-static void _timer_ready_impl(struct iwn_poller *p) {
-  time_t ctime = _time_sec();
-  time_t timeout_next = ctime + 24L * 60 * 60;
-
-  if (ctime != p->timeout_checktime) {
-    IWHMAP_ITER iter;
-    struct poller_slot *h = 0;
-    p->timeout_checktime = ctime;
-
-    pthread_mutex_lock(&p->mtx);
-    iwhmap_iter_init(p->slots, &iter);
-    while (iwhmap_iter_next(&iter)) {
-      struct poller_slot *s = (struct poller_slot*) iter.val;
-      if (!(s->flags & (SLOT_REMOVED | SLOT_REMOVE_PENDING | SLOT_PROCESSING))) {
-        if (s->timeout_limit <= ctime) {
-          ++s->refs;
-          s->timeout_limit = INT_MAX;
-          s->next = h;
-          h = s;
-        } else if (s->timeout_limit < timeout_next) {
-          timeout_next = s->timeout_limit;
-        }
-      }
-    }
-    p->timeout_next = timeout_next;
-    pthread_mutex_unlock(&p->mtx);
-
-    while (h) {
-      struct poller_slot *n = h->next;
-      _slot_remove_unref(p, h->fd);
-      h = n;
-    }
-  }
+#endif
 
-#if defined(IWN_EPOLL)
-  {
-    struct itimerspec next = { { 0, 0 }, { timeout_next - ctime, 0 } };
-    timerfd_settime(p->timer_fd, 0, &next, 0);
+/// Modifies events of slot fd registered in poller.
+static int _slot_ctl_mod(struct poller_slot *s, uint32_t events) {
+  events &= ~SLOT_DISPATCH_FLAGS;
+#if defined(IWN_KQUEUE)
+  int rci = 0;
+  unsigned short ka = _events_to_kflags(events);
+  struct kevent ev[2];
+  if (events & IWN_POLLIN) {
+    ev[rci++] = (struct kevent) {
+      s->fd, EVFILT_READ, EV_ADD | ka
+    };
   }
-#elif defined(IWN_KQUEUE)
-  {
-    struct kevent ev = {
-      .ident  = p->fd,
-      .filter = EVFILT_TIMER,
-      .flags  = EV_ADD | EV_ENABLE | EV_CLEAR | EV_ONESHOT,
-      .fflags = NOTE_SECONDS,
-      .data   = timeout_next - ctime,
+  if (events & IWN_POLLOUT) {
+    ev[rci++] = (struct kevent) {
+      s->fd, EVFILT_WRITE, EV_ADD | ka | EV_DISPATCH
     };
-    if (kevent(p->fd, &ev, 1, 0, 0, 0) == -1) {
-      iwrc rc = iwrc_set_errno(IW_ERROR_ERRNO, errno);
-      iwlog_ecode_error3(rc);
+  }
+  if (rci > 0) {
+    rci = kevent(s->poller->fd, ev, rci, 0, 0, 0);
+  }
+  return rci;
+#elif defined(IWN_EPOLL)
+#if defined(IWN_URING)
+  if (s->poller->uring) {
+    if (!(s->events_mod & IWN_POLLET)) {
+      return _uring_poll_arm(s, events);
+    }
+    // Edge triggered slot fd stays polled by multishot request,
+    // rearm only sets interest events and dispatches them if they are ready already.
+    if (_uring_poll_arm(s, SLOT_EDGE_EVENTS) == -1) {
+      return -1;
     }
+    return _slot_edge_rearm(s, events);
   }
 #endif
-}
-
-IW_INLINE int64_t _timer_ready(const struct iwn_poller_task *t, uint32_t events) {
-  struct iwn_poller *p = t->poller;
-  if (__sync_bool_compare_and_swap(&p->housekeeping, false, true)) {
-    _timer_ready_impl(p);
-    __sync_bool_compare_and_swap(&p->housekeeping, true, false);
+  if (s->events_mod & IWN_POLLPERSIST) {
+    return _slot_edge_rearm(s, events);
   }
-  return 0;
+  if (s->events_mod & EPOLLEXCLUSIVE) {
+    return 0; // Exclusive fd events cannot be modified, IWN_POLLET keeps it armed
+  }
+  struct epoll_event ev = {
+    .events   = events,
+    .data.u64 = _slot_data(s)
+  };
+  return epoll_ctl(s->poller->fd, EPOLL_CTL_MOD, s->fd, &ev);
+#endif
 }
 
-static int64_t _timer_ready_fd(const struct iwn_poller_task *t, uint32_t events) {
-  uint64_t buf;
-  while (read(t->fd, &buf, sizeof(buf)) != -1);
-  return _timer_ready(t, events);
-}
+#if defined(IWN_EPOLL)
 
-IW_INLINE void _timer_check(const struct iwn_poller_task *t, time_t time_limit) {
-  long timeout_next = t->poller->timeout_next;
-  if (time_limit < timeout_next || timeout_next == 0) {
-    _timer_ready(t, 0);
+/// Registers slot fd in poller.
+static int _slot_ctl_add(struct poller_slot *s, uint32_t events) {
+#if defined(IWN_URING)
+  if (s->poller->uring) {
+    return _slot_ctl_mod(s, events);
   }
+#endif
+  if (s->events_mod & IWN_POLLPERSIST) {
+    // Slot interest is set before registration since events may be reported right away
+    _slot_edge_update(s, 0, events & ~(SLOT_DISPATCH_FLAGS | EPOLLET | EPOLLONESHOT | EPOLLEXCLUSIVE), true);
+    events = SLOT_EDGE_EVENTS | (events & EPOLLEXCLUSIVE);
+  }
+  events &= ~SLOT_DISPATCH_FLAGS;
+  struct epoll_event ev = {
+    .events   = events,
+    .data.u64 = _slot_data(s)
+  };
+  return epoll_ctl(s->poller->fd, EPOLL_CTL_ADD, s->fd, &ev);
 }
 
-#if defined(IWN_KQUEUE)
+#endif
 
-iwrc iwn_poller_arm_events(struct iwn_poller *p, int fd, uint32_t events) {
-  int rci = 0;
-  struct poller_slot *s = _slot_peek_leave_locked(p, fd);
-  if (s && !s->abort) {
-    if (s->flags & SLOT_PROCESSING) {
-      s->events_armed |= events;
-    } else {
-      events |= s->events_mod;
-      unsigned short ka = _events_to_kflags(events);
-      struct kevent ev[2];
-      if (events & IWN_POLLIN) {
-        ev[rci++] = (struct kevent) {
-          fd, EVFILT_READ, EV_ADD | ka
-        };
-      }
-      if (events & IWN_POLLOUT) {
-        ev[rci++] = (struct kevent) {
-          fd, EVFILT_WRITE, EV_ADD | ka | EV_DISPATCH
-        };
-      }
-      if (rci > 0) {
-        rci = kevent(p->fd, ev, rci, 0, 0, 0);
+/// Applies `events` to the slot fd. Caller must be the owner of SLOT_REARM state.
+/// Events armed by other threads in the meantime are applied before SLOT_REARM is released.
+static int _slot_rearm(struct poller_slot *s, uint32_t events) {
+  int rci;
+  uint64_t armed, nst, st;
+  while (1) {
+    STATS_ADD(s->poller, rearms, 1);
+    rci = _slot_ctl_mod(s, events);
+    st = atomic_load_explicit(&s->state, memory_order_relaxed);
+    do {
+      armed = (st & SLOT_ARMED_MASK) >> SLOT_ARMED_SHIFT;
+      if (armed && rci != -1 && !(st & SLOT_ABORT)) {
+        nst = st & ~SLOT_ARMED_MASK;
+      } else {
+        nst = st & ~(SLOT_REARM | SLOT_ARMED_MASK);
       }
+    } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, nst,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+    if (!(nst & SLOT_REARM)) {
+      break;
     }
+    events = _events_unpack(armed) | s->events_mod;
   }
-  pthread_mutex_unlock(&p->mtx);
-  if (rci == -1) {
-    return iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
-  }
-  return 0;
+  return rci;
 }
 
-#elif defined(IWN_EPOLL)
+/// Arms slot events. If slot is processing events will be applied
+/// when processing is finished.
+static int _slot_arm(struct poller_slot *s, uint32_t events) {
+  uint64_t nst, st = atomic_load_explicit(&s->state, memory_order_relaxed);
+  do {
+    if (st & SLOT_ABORT) {
+      return 0;
+    }
+    if (st & (SLOT_PROCESSING | SLOT_REARM)) {
+      nst = st | (_events_pack(events) << SLOT_ARMED_SHIFT);
+    } else {
+      nst = st | SLOT_REARM;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, nst,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+  if (st & (SLOT_PROCESSING | SLOT_REARM)) {
+    return 0;
+  }
+  return _slot_rearm(s, events | s->events_mod);
+}
 
 iwrc iwn_poller_arm_events(struct iwn_poller *p, int fd, uint32_t events) {
-  int rci = 0;
-  struct epoll_event ev = { 0 };
-  ev.events = events;
-  ev.data.fd = fd;
-  struct poller_slot *s = _slot_peek_leave_locked(p, fd);
-  if (s && !s->abort) {
-    if (s->flags & SLOT_PROCESSING) {
-      s->events_armed |= ev.events;
-    } else {
-      ev.events |= s->events_mod;
-      rci = epoll_ctl(p->fd, EPOLL_CTL_MOD, fd, &ev);
+  iwrc rc = 0;
+  p = _poller_shard(p, fd);
+  struct poller_slot *s = _slot_ref_id(p, fd, 0);
+  if (s) {
+    if (!_cmd_submit(p, s, CMD_ARM, events) && _slot_arm(s, events) == -1) {
+      rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
     }
+    _slot_unref(s, 0);
   }
-  pthread_mutex_unlock(&p->mtx);
-  if (rci == -1) {
-    return iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+  return rc;
+}
+
+static iwrc _cmd_queue_init(struct iwn_poller *p) {
+  struct cmd_queue *q = malloc(sizeof(*q));
+  if (!q) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->pending, 0);
+  for (size_t i = 0; i < CMD_QUEUE_SIZE; ++i) {
+    atomic_init(&q->cells[i].seq, i);
   }
+  p->cmdq = q;
   return 0;
 }
 
-#endif
-
-#if defined(IWN_KQUEUE)
+static bool _cmd_queue_push(struct cmd_queue *q, const struct cmd *cmd) {
+  size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  while (1) {
+    struct cmd_cell *c = &q->cells[pos & (CMD_QUEUE_SIZE - 1)];
+    intptr_t diff = (intptr_t) atomic_load_explicit(&c->seq, memory_order_acquire) - (intptr_t) pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        c->cmd = *cmd;
+        atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) { // Queue is full
+      return false;
+    } else {
+      pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+  }
+}
 
-static int _next_kevent_identity(struct poller_slot *s) {
-  int ret;
-  pthread_mutex_lock(&s->poller->mtx);
-  if (s->poller->identity_seq == INT_MIN || s->poller->identity_seq >= 0) {
-    s->poller->identity_seq = -1;
+static bool _cmd_queue_pop(struct cmd_queue *q, struct cmd *cmd) {
+  size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+  while (1) {
+    struct cmd_cell *c = &q->cells[pos & (CMD_QUEUE_SIZE - 1)];
+    intptr_t diff = (intptr_t) atomic_load_explicit(&c->seq, memory_order_acquire) - (intptr_t) (pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        *cmd = c->cmd;
+        atomic_store_explicit(&c->seq, pos + CMD_QUEUE_SIZE, memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) { // Queue is empty
+      return false;
+    } else {
+      pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    }
   }
-  ret = --s->poller->identity_seq;
-  pthread_mutex_unlock(&s->poller->mtx);
-  return ret;
 }
 
-#endif
+/// Submits command on slot `s` to the poller command queue.
+/// Only the first command of a batch wakes up the poller.
+/// Returns false if command should be executed by the caller:
+/// the caller is poller's own thread, queue is full or not enabled.
+static bool _cmd_submit(struct iwn_poller *p, struct poller_slot *s, uint32_t op, uint32_t events) {
+  struct cmd_queue *q = p->cmdq;
+  if (!q || _thread_poller == p || p->stop) {
+    return false;
+  }
+  bool pushed = true;
+  int pending = atomic_fetch_add_explicit(&q->pending, 1, memory_order_acq_rel);
+  if (!_cmd_queue_push(q, &(struct cmd) {
+    .fd = s->fd,
+    .gen = s->gen,
+    .events = events,
+    .op = op
+  })) {
+    atomic_fetch_sub_explicit(&q->pending, 1, memory_order_acq_rel);
+    pushed = false;
+  }
+  if (pending == 0) {
+    _poller_poke(p);
+  }
+  return pushed;
+}
 
-static iwrc _poller_timeout_create_fd(struct poller_slot *s) {
-  s->timeout_limit = INT_MAX;
-  if (s->timeout < 1) {
-    return IW_ERROR_INVALID_ARGS;
+static void _cmd_exec(struct iwn_poller *p, const struct cmd *cmd) {
+  struct poller_slot *s = _slot_ref_id(p, cmd->fd, cmd->gen);
+  if (!s) {
+    return;
   }
-  #if defined(IWN_KQUEUE)
-  s->fd = _next_kevent_identity(s);
-  #elif defined(IWN_EPOLL)
-  s->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-  if (s->fd < 0) {
-    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  if (cmd->op == CMD_ARM) {
+    if (_slot_arm(s, cmd->events) == -1) {
+      iwlog_ecode_error3(iwrc_set_errno(IW_ERROR_IO_ERRNO, errno));
+    }
+  } else {
+    _poller_remove(p, cmd->fd);
   }
-  #endif
-  return 0;
+  _slot_unref(s, 0);
 }
 
-static iwrc _poller_timeout_add(struct poller_slot *s) {
-#if defined(IWN_KQUEUE)
-  struct kevent ev = {
-    (unsigned) s->fd, EVFILT_TIMER, EV_ADD | EV_ONESHOT, NOTE_USECONDS, ((int64_t) s->timeout) * 1000
-  };
-  if (kevent(s->poller->fd, &ev, 1, 0, 0, 0) == -1) {
-    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+/// Executes all commands submitted to the poller command queue.
+static void _cmd_drain(struct iwn_poller *p) {
+  struct cmd cmd;
+  struct cmd_queue *q = p->cmdq;
+  if (!q) {
+    return;
   }
-#elif defined(IWN_EPOLL)
-  struct epoll_event ev = { 0 };
-  ev.events = EPOLLIN | EPOLLET | EPOLLONESHOT;
-  ev.data.fd = s->fd;
+  int pending = atomic_load_explicit(&q->pending, memory_order_acquire);
+  while (pending > 0) {
+    int n = 0;
+    while (_cmd_queue_pop(q, &cmd)) {
+      _cmd_exec(p, &cmd);
+      ++n;
+    }
+    if (n == 0) {
+      // Commands are still being pushed by producers or taken by another thread
+      _poller_poke(p);
+      break;
+    }
+    STATS_ADD(p, commands, n);
+    pending = atomic_fetch_sub_explicit(&q->pending, n, memory_order_acq_rel) - n;
+  }
+}
 
-  if (epoll_ctl(s->poller->fd, EPOLL_CTL_ADD, s->fd, &ev) == -1) {
-    return iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+/// Returns poller shard for a new timer task.
+static struct iwn_poller* _poller_timer_shard(struct iwn_poller *p) {
+  if (p->root != p) { // Shard is specified explicitly
+    return p;
   }
-  if (timerfd_settime(s->fd, 0, &(struct itimerspec) {
-    .it_value = {
-      .tv_sec  = s->timeout / 1000,
-      .tv_nsec = (int64_t) (s->timeout % 1000) * 1000000
-    }
-  }, 0) < 0) {
-    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  if (p->num_shards) {
+    unsigned idx = atomic_fetch_add(&p->task_seq, 1) % p->num_shards;
+    return p->shards[idx];
   }
-#endif
-  return 0;
+  return p;
 }
 
-iwrc iwn_poller_add2(const struct iwn_poller_task *task, int *out_fd) {
+/// Registers a task on the given poller shard or on the shard
+/// resolved by the task's fd if `p` is zero.
+static iwrc _poller_add(struct iwn_poller *p, const struct iwn_poller_task *task, int *out_fd) {
   if (!task || !task->poller || (!(task->events & IWN_POLLTIMEOUT) && task->fd < 0)) {
     return IW_ERROR_INVALID_ARGS;
   }
-  iwrc rc;
-  struct iwn_poller *p = task->poller;
-  struct poller_slot *s = calloc(1, sizeof(*s));
-  if (!s) {
-    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
-  }
-  memcpy(s, task, sizeof(*task));
+  iwrc rc = 0;
+  int fd = task->fd;
+  struct poller_slot *s;
+  uint64_t st = 0;
 
   if (task->events & IWN_POLLTIMEOUT) {
-    s->fd = -1;
-    rc = _poller_timeout_create_fd(s);
-    if (rc) {
-      free(s);
-      return rc;
+    if (task->timeout < 1) {
+      return IW_ERROR_INVALID_ARGS;
     }
+    if (!p) {
+      p = _poller_timer_shard(task->poller);
+    }
+    fd = _timer_handle_acquire(p);
+    if (!fd) {
+      return IW_ERROR_OVERFLOW;
+    }
+  } else if (!p) {
+    p = _poller_shard(task->poller, fd);
+  }
+  s = _slot_ensure(p, fd);
+  if (!s) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    goto failure;
+  }
+  if (!atomic_compare_exchange_strong(&s->state, &st, SLOT_INIT)) {
+    iwlog_error("FD: %d is managed already, poller: %d", fd, p->fd);
+    rc = IW_ERROR_INVALID_STATE;
+    goto failure;
   }
 
-  rc = _slot_ref(s);
-  if (rc) {
-    if ((task->events & IWN_POLLTIMEOUT) && s->fd > -1) {
-      close(s->fd);
-    }
-    free(s);
-    return rc;
+  memcpy(s, task, sizeof(*task));
+  s->fd = fd;
+  s->poller = p;
+  s->events_processing = 0;
+  if (s->events_mod & IWN_POLLPERSIST) {
+    s->events_mod |= IWN_POLLET;
+  }
+  atomic_store(&s->timeout_limit, INT64_MAX);
+#if defined(IWN_EPOLL)
+  atomic_store(&s->edge, 0);
+  atomic_store(&s->edge_tick, 0);
+#endif
+#if defined(IWN_URING)
+  atomic_store(&s->polling, 0);
+#endif
+  s->gen += 2;
+  if (s->gen == 0) {
+    s->gen = 2;
   }
+  ++p->fds_count;
+  atomic_store_explicit(&s->state, SLOT_ACTIVE | 1, memory_order_release);
 
   if (IW_UNLIKELY(task->events & IWN_POLLTIMEOUT)) {
-    rc = _poller_timeout_add(s);
+    _slot_deadline_set(s, _time_ms() + s->timeout);
   } else {
 #if defined(IWN_KQUEUE)
 
@@ -585,11 +1755,7 @@ iwrc iwn_poller_add2(const struct iwn_poller_task *task, int *out_fd) {
 
 #elif defined(IWN_EPOLL)
 
-    struct epoll_event ev = { 0 };
-    ev.events = s->events | s->events_mod;
-    ev.data.fd = s->fd;
-
-    if (epoll_ctl(p->fd, EPOLL_CTL_ADD, s->fd, &ev) == -1) {
+    if (_slot_ctl_add(s, s->events | s->events_mod) == -1) {
       rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
       goto finish;
     }
@@ -597,85 +1763,108 @@ iwrc iwn_poller_add2(const struct iwn_poller_task *task, int *out_fd) {
 #endif
 
     if (s->timeout > 0) {
-      s->timeout_limit = _time_sec() + s->timeout;
-      _timer_check((void*) s, s->timeout_limit);
-    } else {
-      s->timeout_limit = INT_MAX;
+      _slot_deadline_set(s, _time_ms() + (int64_t) s->timeout * 1000);
     }
   }
 
 finish:
   if (rc) {
     s->on_dispose = 0;
-    iwn_poller_remove(p, s->fd);
+    _poller_remove(p, fd);
   } else if (out_fd) {
-    *out_fd = s->fd;
+    *out_fd = fd;
+  }
+  return rc;
+
+failure:
+  if (task->events & IWN_POLLTIMEOUT) {
+    _timer_handle_release(p, fd);
   }
   return rc;
 }
 
+iwrc iwn_poller_add2(const struct iwn_poller_task *task, int *out_fd) {
+  return _poller_add(0, task, out_fd);
+}
+
 iwrc iwn_poller_add(const struct iwn_poller_task *task) {
-  return iwn_poller_add2(task, 0);
+  return _poller_add(0, task, 0);
 }
 
 bool iwn_poller_fd_is_managed(struct iwn_poller *p, int fd) {
-  bool ret;
-  pthread_mutex_lock(&p->mtx);
-  ret = iwhmap_get_u32(p->slots, fd) != 0;
-  pthread_mutex_unlock(&p->mtx);
-  return ret;
+  p = _poller_shard(p, fd);
+  struct poller_slot *s = _slot_at(p, fd);
+  return s && (atomic_load(&s->state) & (SLOT_ACTIVE | SLOT_REMOVED)) == SLOT_ACTIVE;
 }
 
 bool iwn_poller_fd_ref(struct iwn_poller *p, int fd, int refs) {
-  bool ret = false, destroy = false;
-  pthread_mutex_lock(&p->mtx);
-  struct poller_slot *s = iwhmap_get_u32(p->slots, fd);
-  if (s) {
-    ret = true;
-    s->refs += refs;
-    destroy = s->refs == 0;
-    if (destroy) {
-      s->flags |= SLOT_REMOVED;
-      _rw_fd_unsubscribe(s);
-      if (iwhmap_remove_u32(p->slots, s->fd)) {
-        --p->fds_count;
-#if defined(IWN_EPOLL)
-        if (p->fds_count < 3) {
-#elif defined(IWN_KQUEUE)
-        if (p->fds_count < 1) {
-#endif
-          iwn_poller_shutdown_request(p);
-        }
-      }
-    }
+  p = _poller_shard(p, fd);
+  struct poller_slot *s = _slot_at(p, fd);
+  if (!s) {
+    return false;
   }
-  pthread_mutex_unlock(&p->mtx);
-  if (destroy) {
+  uint64_t nst, st = atomic_load_explicit(&s->state, memory_order_relaxed);
+  do {
+    if ((st & (SLOT_ACTIVE | SLOT_REMOVED)) != SLOT_ACTIVE) {
+      return false;
+    }
+    int64_t nrefs = (int64_t) (st & SLOT_REFS_MASK) + refs;
+    if (nrefs < 0) {
+      nrefs = 0;
+    }
+    nst = (st & ~SLOT_REFS_MASK) | (uint64_t) nrefs;
+    if (nrefs == 0) {
+      nst |= SLOT_REMOVED;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, nst,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+  if (nst & SLOT_REMOVED) {
+    _slot_removed(s);
     _slot_destroy(s);
   }
-  return ret;
+  return true;
 }
 
-void iwn_poller_set_timeout(struct iwn_poller *p, int fd, long timeout_sec) {
-  struct poller_slot *s = _slot_peek_leave_locked(p, fd);
-  if (!s || s->timeout == timeout_sec || (s->events & IWN_POLLTIMEOUT)) {
-    pthread_mutex_unlock(&p->mtx);
+void iwn_poller_edge_drained(struct iwn_poller *p, int fd, uint32_t events) {
+#if defined(IWN_EPOLL)
+  p = _poller_shard(p, fd);
+  struct poller_slot *s = _slot_at(p, fd);
+  if (  !s || !(s->events_mod & IWN_POLLPERSIST)
+     || !(atomic_load_explicit(&s->state, memory_order_relaxed) & SLOT_ACTIVE)) {
     return;
   }
-  if (timeout_sec > 0) {
-    s->timeout = timeout_sec;
-    s->timeout_limit = _time_sec() + s->timeout;
-  } else {
-    s->timeout = 0;
-    s->timeout_limit = INT_MAX;
+  uint32_t tick = atomic_load_explicit(&s->edge_tick, memory_order_relaxed);
+  uint64_t nst, st = atomic_load_explicit(&s->edge, memory_order_relaxed);
+  do {
+    if (((uint32_t) st >> EDGE_TICK_SHIFT) != tick) {
+      // Events have been received since dispatch, these may be not observed by the caller
+      return;
+    }
+    nst = st & ~(uint64_t) (events & EDGE_READY_MASK);
+  } while (!atomic_compare_exchange_weak_explicit(&s->edge, &st, nst,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+#endif
+}
+
+void iwn_poller_set_timeout(struct iwn_poller *p, int fd, long timeout_sec) {
+  p = _poller_shard(p, fd);
+  struct poller_slot *s = _slot_ref_id(p, fd, 0);
+  if (!s) {
+    return;
   }
-  pthread_mutex_unlock(&p->mtx);
-  if (timeout_sec > 0) {
-    _timer_check((void*) s, s->timeout_limit);
+  if (s->timeout != timeout_sec && !(s->events & IWN_POLLTIMEOUT)) {
+    if (timeout_sec > 0) {
+      s->timeout = timeout_sec;
+      _slot_deadline_set(s, _time_ms() + (int64_t) timeout_sec * 1000);
+    } else {
+      s->timeout = 0;
+      _slot_deadline_set(s, INT64_MAX);
+    }
   }
+  _slot_unref(s, 0);
 }
 
-void iwn_poller_poke(struct iwn_poller *p) {
+static void _poller_poke(struct iwn_poller *p) {
 #if defined(IWN_KQUEUE)
   {
     struct kevent ev[] = {
@@ -696,9 +1885,29 @@ void iwn_poller_poke(struct iwn_poller *p) {
 #endif
 }
 
+void iwn_poller_poke(struct iwn_poller *p) {
+  p = p->root;
+  if (p->num_shards) {
+    for (int i = 0; i < p->num_shards; ++i) {
+      _poller_poke(p->shards[i]);
+    }
+  } else {
+    _poller_poke(p);
+  }
+}
+
 void iwn_poller_shutdown_request(struct iwn_poller *p) {
-  if (p && __sync_bool_compare_and_swap(&p->stop, false, true)) {
-    iwn_poller_poke(p);
+  if (!p) {
+    return;
+  }
+  p = p->root;
+  if (p->num_shards) {
+    p->stop = true;
+    for (int i = 0; i < p->num_shards; ++i) {
+      _poller_shutdown(p->shards[i]);
+    }
+  } else {
+    _poller_shutdown(p);
   }
 }
 
@@ -715,6 +1924,17 @@ static void _on_eventfd_dispose(const struct iwn_poller_task *t) {
   t->poller->event_fd = -1;
 }
 
+static int64_t _on_eventfd_ready(const struct iwn_poller_task *t, uint32_t events) {
+  uint64_t buf;
+  while (read(t->fd, &buf, sizeof(buf)) != -1);
+  _cmd_drain(t->poller);
+  if (t->poller->stop) {
+    // Keep shutdown request visible to poll threads not yet woken up
+    _poller_poke(t->poller);
+  }
+  return 0;
+}
+
 static iwrc _eventfd_ensure(struct iwn_poller *p) {
   iwrc rc = 0;
   if (p->event_fd > -1) {
@@ -727,12 +1947,14 @@ static iwrc _eventfd_ensure(struct iwn_poller *p) {
    #if EFD_CLOEXEC == 0
 #endif
   RCN(finish, fcntl(p->event_fd, F_SETFD, FD_CLOEXEC));
-  RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+  RCC(rc, finish, _poller_add(p, &(struct iwn_poller_task) {
     .poller = p,
     .fd = p->event_fd,
+    .on_ready = _on_eventfd_ready,
     .on_dispose = _on_eventfd_dispose,
-    .events = IWN_POLLIN
-  }));
+    .events = IWN_POLLIN,
+    .events_mod = IWN_POLLINLINE, // Commands are drained by reactor thread without worker wakeup
+  }, 0));
 
 finish:
   return rc;
@@ -747,24 +1969,235 @@ static iwrc _timerfd_ensure(struct iwn_poller *p) {
   if (p->timer_fd > -1) {
     return 0;
   }
-  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-  RCN(finish, fd);
-  p->timer_fd = fd;
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  RCN(finish, fd);
+  p->timer_fd = fd;
+
+  RCC(rc, finish, _poller_add(p, &(struct iwn_poller_task) {
+    .poller = p,
+    .fd = p->timer_fd,
+    .on_ready = _timer_ready_fd,
+    .on_dispose = _on_timerfd_dispose,
+    .events = IWN_POLLIN,
+    .events_mod = IWN_POLLET
+  }, 0));
+
+  pthread_mutex_lock(&p->wheel.mtx);
+  p->wheel.armed = INT64_MAX;
+  _timer_arm(p, _wheel_next(&p->wheel));
+  pthread_mutex_unlock(&p->wheel.mtx);
+
+finish:
+  return rc;
+}
+
+#endif
+
+static iwrc _shard_create(const struct iwn_poller_spec *spec, struct iwn_poller **out_poller) {
+  iwrc rc = 0;
+  struct iwn_poller *p = calloc(1, sizeof(*p));
+  if (!p) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  p->fd = -1;
+  p->root = p;
+  p->flags = spec->flags & (IWN_POLLER_POLL_NO_FDS | IWN_POLLER_INLINE | IWN_POLLER_STATS);
+  p->stats_id = atomic_fetch_add(&_stats_seq, 1) + 1;
+#ifdef IWN_EPOLL
+  p->timer_fd = -1;
+  p->event_fd = -1;
+#endif
+  p->max_poll_events = spec->one_shot_events;
+  p->num_poll_threads = spec->num_poll_threads;
+  p->busy_poll_us = spec->busy_poll_us;
+  p->busy_poll_budget = spec->busy_poll_us;
+
+  RCN(finish, pthread_mutex_init(&p->mtx, 0));
+  RCN(finish, pthread_mutex_init(&p->wheel.mtx, 0));
+  _wheel_init(&p->wheel);
+  if (spec->flags & IWN_POLLER_CMD_QUEUE) {
+    RCC(rc, finish, _cmd_queue_init(p));
+  }
+  if (spec->flags & IWN_POLLER_WORK_STEALING) {
+    RCC(rc, finish, iwn_wstp_start_by_spec(&(struct iwn_wstp_spec) {
+      .num_threads = spec->num_threads,
+      .queue_limit = spec->queue_limit,
+      .thread_name_prefix = "poller-wstp-",
+    }, &p->wstp));
+  } else {
+    RCC(rc, finish, iwtp_start_by_spec(&(struct iwtp_spec) {
+      .num_threads = spec->num_threads,
+      .overflow_threads_factor = spec->overflow_threads_factor,
+      .queue_limit = spec->queue_limit,
+      .thread_name_prefix = "poller-tp-",
+      .warn_on_overflow_thread_spawn = spec->warn_on_overflow_thread_spawn,
+    }, &p->tp));
+  }
+  if (spec->num_priority_threads > 0) {
+    RCC(rc, finish, iwtp_start_by_spec(&(struct iwtp_spec) {
+      .num_threads = spec->num_priority_threads,
+      .thread_name_prefix = "poller-prio-",
+    }, &p->tp_prio));
+  }
+  if (spec->num_background_threads > 0) {
+    RCC(rc, finish, iwtp_start_by_spec(&(struct iwtp_spec) {
+      .num_threads = spec->num_background_threads,
+      .queue_limit = spec->queue_limit,
+      .thread_name_prefix = "poller-bg-",
+    }, &p->tp_bg));
+  }
+
+#if defined(IWN_KQUEUE)
+  RCN(finish, p->fd = kqueue());
+#elif defined(IWN_EPOLL)
+#if defined(IWN_URING)
+  if (spec->flags & IWN_POLLER_URING) {
+    iwrc rc2 = _uring_create(&p->uring);
+    if (rc2) {
+      iwlog_ecode_warn(rc2, "io_uring is not available, falling back to epoll");
+    } else {
+      p->fd = p->uring->fd;
+      p->num_poll_threads = 1;
+    }
+  }
+  if (p->fd == -1)
+#endif
+  RCN(finish, p->fd = epoll_create1(EPOLL_CLOEXEC));
+  RCC(rc, finish, _eventfd_ensure(p));
+  RCC(rc, finish, _timerfd_ensure(p));
+#endif
+
+finish:
+  if (rc) {
+    _destroy(p);
+  } else {
+    *out_poller = p;
+  }
+  return rc;
+}
+
+#if defined(__linux__)
+
+/// Reads cpu list file in format of `/sys/devices/system/node/node*/cpulist`, eg: `0-3,8-11`.
+static bool _cpulist_read(const char *path, cpu_set_t *set) {
+  char buf[1024];
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[len] = '\0';
+
+  CPU_ZERO(set);
+  for (char *rp = buf, *ep; *rp; rp = ep + 1) {
+    long lo = strtol(rp, &ep, 10), hi = lo;
+    if (ep == rp) {
+      break;
+    }
+    if (*ep == '-') {
+      rp = ep + 1;
+      hi = strtol(rp, &ep, 10);
+      if (ep == rp) {
+        break;
+      }
+    }
+    for (long c = lo; c <= hi && c < CPU_SETSIZE; ++c) {
+      CPU_SET(c, set);
+    }
+    if (*ep != ',') {
+      break;
+    }
+  }
+  return CPU_COUNT(set) > 0;
+}
+
+#endif
+
+/// Assigns cpu cores to poller shards according to iwn_poller_spec::cpus and IWN_POLLER_NUMA flag.
+static iwrc _affinity_init(struct iwn_poller *p, const struct iwn_poller_spec *spec) {
+  bool numa = spec->flags & IWN_POLLER_NUMA;
+  if (!numa && (!spec->cpus || spec->num_cpus < 1)) {
+    return 0;
+  }
+#if defined(__linux__)
+  iwrc rc = 0;
+  struct iwn_poller **shards = p->num_shards ? p->shards : &p;
+  int num_shards = p->num_shards ? p->num_shards : 1;
+  int ngroups = 0;
+  cpu_set_t allowed, *groups = 0;
+
+  CPU_ZERO(&allowed);
+  if (spec->cpus && spec->num_cpus > 0) {
+    for (int i = 0; i < spec->num_cpus; ++i) {
+      if (spec->cpus[i] >= 0 && spec->cpus[i] < CPU_SETSIZE) {
+        CPU_SET(spec->cpus[i], &allowed);
+      }
+    }
+  } else {
+    RCN(finish, sched_getaffinity(0, sizeof(allowed), &allowed));
+  }
+  if (CPU_COUNT(&allowed) == 0) {
+    rc = IW_ERROR_INVALID_ARGS;
+    goto finish;
+  }
+  RCB(finish, groups = malloc(MAX(NUMA_NODES_MAX, num_shards) * sizeof(*groups)));
+
+  if (numa) {
+    // Every NUMA node forms a group of cores
+    for (int i = 0; i < NUMA_NODES_MAX; ++i) {
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", i);
+      if (_cpulist_read(path, &groups[ngroups])) {
+        CPU_AND(&groups[ngroups], &groups[ngroups], &allowed);
+        if (CPU_COUNT(&groups[ngroups]) > 0) {
+          ++ngroups;
+        }
+      }
+    }
+    if (ngroups == 0) {
+      groups[ngroups++] = allowed;
+    }
+  } else {
+    // Cores are distributed between shards round-robin
+    ngroups = MIN(num_shards, CPU_COUNT(&allowed));
+    for (int i = 0; i < ngroups; ++i) {
+      CPU_ZERO(&groups[i]);
+    }
+    for (int c = 0, j = 0; c < CPU_SETSIZE; ++c) {
+      if (CPU_ISSET(c, &allowed)) {
+        CPU_SET(c, &groups[j++ % ngroups]);
+      }
+    }
+  }
 
-  RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
-    .poller = p,
-    .fd = p->timer_fd,
-    .on_ready = _timer_ready_fd,
-    .on_dispose = _on_timerfd_dispose,
-    .events = IWN_POLLIN,
-    .events_mod = IWN_POLLET
-  }));
+  for (int i = 0; i < num_shards; ++i) {
+    RCB(finish, shards[i]->cpuset = malloc(sizeof(*shards[i]->cpuset)));
+    *shards[i]->cpuset = groups[i % ngroups];
+  }
 
 finish:
+  free(groups);
   return rc;
+#else
+  iwlog_warn2("CPU affinity of poller threads is not supported on this platform");
+  return 0;
+#endif
 }
 
+/// Pins the current thread to cpu cores of poller `p` if it has not been done yet.
+IW_INLINE void _affinity_ensure(struct iwn_poller *p) {
+#if defined(__linux__)
+  static __thread struct iwn_poller *pinned;
+  if (IW_UNLIKELY(p->cpuset && pinned != p)) {
+    pinned = p;
+    int rci = pthread_setaffinity_np(pthread_self(), sizeof(*p->cpuset), p->cpuset);
+    if (rci) {
+      iwlog_ecode_warn(iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci), "Failed to set poller thread affinity");
+    }
+  }
 #endif
+}
 
 static iwrc _create(const struct iwn_poller_spec *spec_, struct iwn_poller **out_poller) {
   if (!out_poller || !spec_) {
@@ -782,6 +2215,37 @@ static iwrc _create(const struct iwn_poller_spec *spec_, struct iwn_poller **out
   if (spec.one_shot_events > 128) {
     spec.one_shot_events = 128;
   }
+  if (spec.num_shards < 0) {
+    spec.num_shards = iwp_num_cpu_cores();
+  }
+  if (spec.num_shards > SHARDS_MAX) {
+    spec.num_shards = SHARDS_MAX;
+  }
+  if (spec.num_poll_threads < 1) {
+    spec.num_poll_threads = 1;
+  }
+  if (spec.num_poll_threads > POLL_THREADS_MAX) {
+    spec.num_poll_threads = POLL_THREADS_MAX;
+  }
+  spec.num_priority_threads = MIN(MAX(spec.num_priority_threads, 0), 1024);
+  spec.num_background_threads = MIN(MAX(spec.num_background_threads, 0), 1024);
+  if (spec.busy_poll_us < 0) {
+    spec.busy_poll_us = 0;
+  }
+  if (spec.busy_poll_us > BUSY_POLL_MAX_US) {
+    spec.busy_poll_us = BUSY_POLL_MAX_US;
+  }
+  if (spec.num_shards < 2) {
+    iwrc rc = _shard_create(&spec, out_poller);
+    if (!rc) {
+      rc = _affinity_init(*out_poller, &spec);
+      if (rc) {
+        _destroy(*out_poller);
+        *out_poller = 0;
+      }
+    }
+    return rc;
+  }
 
   iwrc rc = 0;
   struct iwn_poller *p = calloc(1, sizeof(*p));
@@ -789,30 +2253,31 @@ static iwrc _create(const struct iwn_poller_spec *spec_, struct iwn_poller **out
     return iwrc_set_errno(IW_ERROR_ALLOC, errno);
   }
   p->fd = -1;
-  p->flags = spec.flags & (IWN_POLLER_POLL_NO_FDS);
+  p->root = p;
+  p->flags = spec.flags & (IWN_POLLER_POLL_NO_FDS | IWN_POLLER_INLINE | IWN_POLLER_STATS);
 #ifdef IWN_EPOLL
   p->timer_fd = -1;
   p->event_fd = -1;
 #endif
-  p->max_poll_events = spec.one_shot_events;
 
   RCN(finish, pthread_mutex_init(&p->mtx, 0));
-  RCB(finish, p->slots = iwhmap_create_u32(0));
-  RCC(rc, finish, iwtp_start_by_spec(&(struct iwtp_spec) {
-    .num_threads = spec.num_threads,
-    .overflow_threads_factor = spec.overflow_threads_factor,
-    .queue_limit = spec.queue_limit,
-    .thread_name_prefix = "poller-tp-",
-    .warn_on_overflow_thread_spawn = spec.warn_on_overflow_thread_spawn,
-  }, &p->tp));
+  RCB(finish, p->shards = calloc(spec.num_shards, sizeof(*p->shards)));
 
-#if defined(IWN_KQUEUE)
-  RCN(finish, p->fd = kqueue());
-#elif defined(IWN_EPOLL)
-  RCN(finish, p->fd = epoll_create1(EPOLL_CLOEXEC));
-  RCC(rc, finish, _eventfd_ensure(p));
-  RCC(rc, finish, _timerfd_ensure(p));
-#endif
+  spec.num_threads = MAX(1, spec.num_threads / spec.num_shards);
+  if (spec.num_priority_threads) {
+    spec.num_priority_threads = MAX(1, spec.num_priority_threads / spec.num_shards);
+  }
+  if (spec.num_background_threads) {
+    spec.num_background_threads = MAX(1, spec.num_background_threads / spec.num_shards);
+  }
+  for ( ; p->num_shards < spec.num_shards; ++p->num_shards) {
+    struct iwn_poller *shard;
+    RCC(rc, finish, _shard_create(&spec, &shard));
+    shard->root = p;
+    shard->idx = p->num_shards;
+    p->shards[p->num_shards] = shard;
+  }
+  RCC(rc, finish, _affinity_init(p, &spec));
 
 finish:
   if (rc) {
@@ -834,101 +2299,212 @@ iwrc iwn_poller_create(int num_threads, int one_shot_events, struct iwn_poller *
   }, out_poller);
 }
 
+/// Executes slot handler collecting its statistics.
+static void _worker_run_stats(struct poller_slot *s, uint32_t events, int64_t *out_n) {
+  struct stats_block *b = _stats_block(s->poller);
+  int64_t ts = _time_us();
+  if (b && s->dispatched_us) {
+    _stats_hist_add(&b->dispatch_delay, ts - s->dispatched_us);
+  }
+  s->dispatched_us = 0;
+  *out_n = s->on_ready ? s->on_ready((void*) s, events) : 0;
+  if (b) {
+    _stats_hist_add(&b->handler_time, _time_us() - ts);
+  }
+}
+
+/// Schedules the next firing of the timer task slot after `delay` milliseconds.
+/// Releases caller's slot reference.
+static void _slot_timer_repeat(struct poller_slot *s, int64_t delay) {
+  // Processing flag is cleared first since timing wheel skips slots being processed
+  atomic_fetch_and(&s->state, ~SLOT_PROCESSING);
+  _slot_deadline_set(s, _time_ms() + delay);
+  _slot_unref(s, 0);
+}
+
 static void _worker_fn(void *arg) {
   int64_t n;
   int rci = 0;
-  long timeout = 0;
-  bool destroy = false, abort = false;
   struct poller_slot *s = arg;
-  struct iwn_poller *p = s->poller;
   uint32_t events = s->events_processing;
-  int fd = s->fd;
+  uint64_t nst, st;
+
+  _affinity_ensure(s->poller);
+  _thread_poller = s->poller;
 
 start:
 
-  if (s->on_ready) {
+  if (IW_UNLIKELY(_stats_enabled(s->poller))) {
+    _worker_run_stats(s, events, &n);
+  } else if (s->on_ready) {
     n = s->on_ready((void*) s, events);
   } else {
     n = 0;
   }
   if (s->events & IWN_POLLTIMEOUT) {
+    if (n > 0 && !(atomic_load(&s->state) & SLOT_REMOVE_PENDING)) {
+      _slot_timer_repeat(s, n);
+      return;
+    }
     n = -1;
   }
   if (n < 0) {
-    rci = -1;
-    destroy = _slot_unref(s, REF_DESTROY_DEFER);
-    goto finish;
+    _slot_remove_unref(s);
+    return;
   } else if (n > 0) {
     events = (uint32_t) n;
   } else {
     events = s->events;
   }
 
-  pthread_mutex_lock(&p->mtx);
-  abort = s->abort;
-  if (s->events_update) {
-    events = s->events_update;
-    s->events_update = 0;
-    pthread_mutex_unlock(&p->mtx);
+  st = atomic_load_explicit(&s->state, memory_order_relaxed);
+  do {
+    if (st & SLOT_UPDATE_MASK) {
+      nst = st & ~SLOT_UPDATE_MASK;
+    } else if (st & SLOT_REARM) {
+      // Somebody is rearming slot right now, pass our events to it
+      nst = (st & ~SLOT_PROCESSING) | (_events_pack(events | s->events_mod) << SLOT_ARMED_SHIFT);
+    } else {
+      nst = (st & ~(SLOT_PROCESSING | SLOT_ARMED_MASK)) | SLOT_REARM;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, nst,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+
+  if (st & SLOT_UPDATE_MASK) {
+    events = _events_unpack((st & SLOT_UPDATE_MASK) >> SLOT_UPDATE_SHIFT);
+    STATS_ADD(s->poller, updates, 1);
     goto start;
   }
 
-  s->flags &= ~SLOT_PROCESSING;
-  events = events | s->events_mod | s->events_armed;
-  s->events_armed = 0;
+  bool abort = st & SLOT_ABORT;
+  if (!(st & SLOT_REARM)) {
+    if (abort) {
+      atomic_fetch_and(&s->state, ~SLOT_REARM);
+    } else {
+      events |= s->events_mod | _events_unpack((st & SLOT_ARMED_MASK) >> SLOT_ARMED_SHIFT);
+      rci = _slot_rearm(s, events);
+    }
+  }
 
-  if (!abort) {
-#if defined(IWN_KQUEUE)
-    {
-      unsigned short ka = _events_to_kflags(events);
-      struct kevent ev[2];
-      if (events & IWN_POLLIN) {
-        ev[rci++] = (struct kevent) {
-          fd, EVFILT_READ, EV_ADD | ka
-        };
-      }
-      if (events & IWN_POLLOUT) {
-        ev[rci++] = (struct kevent) {
-          fd, EVFILT_WRITE, EV_ADD | ka | EV_DISPATCH
-        };
-      }
-      if (rci > 0) {
-        rci = kevent(p->fd, ev, rci, 0, 0, 0);
-      }
+  if (abort || rci < 0) {
+    _slot_remove_unref(s);
+  } else {
+    long timeout = s->timeout;
+    if (timeout > 0) {
+      _slot_deadline_set(s, _time_ms() + (int64_t) timeout * 1000);
     }
-#elif defined(IWN_EPOLL)
-    struct epoll_event ev = { 0 };
-    ev.data.fd = fd;
-    ev.events = events;
-    rci = epoll_ctl(p->fd, EPOLL_CTL_MOD, ev.data.fd, &ev);
-#endif
+    _slot_unref(s, 0);
   }
+}
 
-  destroy = _slot_unref(s, REF_LOCKED);
-  timeout = s->timeout;
-  pthread_mutex_unlock(&p->mtx);
+static void _stats_hist_sum(struct iwn_poller_histogram *h, struct stats_hist *sh) {
+  h->count += atomic_load_explicit(&sh->count, memory_order_relaxed);
+  h->sum += atomic_load_explicit(&sh->sum, memory_order_relaxed);
+  h->max = MAX(h->max, atomic_load_explicit(&sh->max, memory_order_relaxed));
+  for (int i = 0; i < IWN_POLLER_HISTOGRAM_BUCKETS; ++i) {
+    h->buckets[i] += atomic_load_explicit(&sh->buckets[i], memory_order_relaxed);
+  }
+}
 
-finish:
-  if (destroy) {
-    _slot_destroy(s);
-  } else if (abort || rci < 0) {
-    iwn_poller_remove(p, fd);
-  } else if (timeout > 0) {
-    long timeout_limit = _time_sec() + timeout;
-    s->timeout_limit = timeout_limit;
-    _timer_check((void*) s, timeout_limit);
+/// Returns number of pending tasks of all worker lanes of the poller shard.
+static int _poller_queue_size(struct iwn_poller *p) {
+  int ret = 0;
+  if (p->wstp) {
+    ret += iwn_wstp_queue_size(p->wstp);
+  } else if (p->tp) {
+    ret += iwtp_queue_size(p->tp);
+  }
+  if (p->tp_prio) {
+    ret += iwtp_queue_size(p->tp_prio);
+  }
+  if (p->tp_bg) {
+    ret += iwtp_queue_size(p->tp_bg);
+  }
+  return ret;
+}
+
+static void _stats_sum(struct iwn_poller *p, struct iwn_poller_stats *stats) {
+  for (struct stats_block *b = atomic_load(&p->stats); b; b = b->next) {
+    stats->polls += atomic_load_explicit(&b->polls, memory_order_relaxed);
+    stats->events += atomic_load_explicit(&b->events, memory_order_relaxed);
+    stats->dispatches += atomic_load_explicit(&b->dispatches, memory_order_relaxed);
+    stats->inline_dispatches += atomic_load_explicit(&b->inline_dispatches, memory_order_relaxed);
+    stats->updates += atomic_load_explicit(&b->updates, memory_order_relaxed);
+    stats->rearms += atomic_load_explicit(&b->rearms, memory_order_relaxed);
+    stats->timeouts += atomic_load_explicit(&b->timeouts, memory_order_relaxed);
+    stats->busy_polls += atomic_load_explicit(&b->busy_polls, memory_order_relaxed);
+    stats->commands += atomic_load_explicit(&b->commands, memory_order_relaxed);
+    _stats_hist_sum(&stats->dispatch_delay, &b->dispatch_delay);
+    _stats_hist_sum(&stats->handler_time, &b->handler_time);
+  }
+  stats->fds += MAX(0, p->fds_count - SERVICE_FDS);
+  stats->queue_size += _poller_queue_size(p);
+}
+
+void iwn_poller_stats(struct iwn_poller *p, struct iwn_poller_stats *stats) {
+  if (!stats) {
+    return;
+  }
+  memset(stats, 0, sizeof(*stats));
+  if (!p) {
+    return;
+  }
+  p = p->root;
+  if (p->num_shards) {
+    for (int i = 0; i < p->num_shards; ++i) {
+      _stats_sum(p->shards[i], stats);
+    }
+  } else {
+    _stats_sum(p, stats);
+  }
+}
+
+int iwn_poller_queue_size(struct iwn_poller *p) {
+  int ret = 0;
+  if (!p) {
+    return 0;
+  }
+  p = p->root;
+  if (p->num_shards) {
+    for (int i = 0; i < p->num_shards; ++i) {
+      ret += _poller_queue_size(p->shards[i]);
+    }
+  } else {
+    ret = _poller_queue_size(p);
+  }
+  return ret;
+}
+
+bool iwn_poller_uses_uring(struct iwn_poller *p) {
+#if defined(IWN_URING)
+  p = p->root;
+  if (p->num_shards) {
+    p = p->shards[0];
   }
+  return p->uring != 0;
+#else
+  return false;
+#endif
 }
 
 bool iwn_poller_alive(struct iwn_poller *p) {
-  return p && !p->stop;
+  return p && !p->root->stop;
+}
+
+iwrc iwn_poller_task_prio(struct iwn_poller *p, void (*task)(void*), void *arg, int prio) {
+  if (p->num_shards) {
+    unsigned idx = atomic_fetch_add(&p->task_seq, 1) % p->num_shards;
+    p = p->shards[idx];
+  }
+  return _poller_schedule(p, prio, task, arg);
 }
 
 iwrc iwn_poller_task(struct iwn_poller *p, void (*task)(void*), void *arg) {
-  return iwtp_schedule(p->tp, task, arg);
+  return iwn_poller_task_prio(p, task, arg, IWN_POLLER_PRIO_NORMAL);
 }
 
 bool iwn_poller_probe(struct iwn_poller *p, int fd, iwn_poller_probe_fn probe, void *fn_user_data) {
+  p = _poller_shard(p, fd);
   struct poller_slot *s = _slot_ref_id(p, fd, 0);
   if (s) {
     probe(p, s->user_data, fn_user_data);
@@ -947,6 +2523,7 @@ static void* _poll_worker(void *d) {
 
 iwrc iwn_poller_poll_in_thread(struct iwn_poller *p, const char *thr_name, pthread_t *out_thr) {
   iwrc rc = 0;
+  p = p->root;
   if (thr_name) {
     p->thread_name = strdup(thr_name);
   }
@@ -957,38 +2534,235 @@ finish:
 }
 
 void iwn_poller_flags_set(struct iwn_poller *p, uint32_t flags) {
+  p = p->root;
   p->flags = flags;
+  for (int i = 0; i < p->num_shards; ++i) {
+    p->shards[i]->flags = flags;
+  }
 }
 
-void iwn_poller_poll(struct iwn_poller *p) {
-  if (p->thread_name) {
-    iwp_set_current_thread_name(p->thread_name);
-    free(p->thread_name);
-    p->thread_name = 0;
+/// Returns true if slot `on_ready()` handler should be executed by the reactor thread.
+IW_INLINE bool _slot_is_inline(const struct poller_slot *s) {
+  return (s->events_mod & IWN_POLLINLINE)
+         || ((s->poller->flags & IWN_POLLER_INLINE) && !(s->events_mod & IWN_POLLBLOCKING));
+}
+
+/// Dispatches slot `events` to the poller worker pool or executes slot handler right away
+/// if `reactor` thread is the caller and slot is inline. Consumes caller's reference on slot.
+static void _slot_dispatch(struct poller_slot *s, uint32_t events, bool abort, bool reactor) {
+  struct iwn_poller *p = s->poller;
+  if (IW_UNLIKELY(!events)) {
+    uint64_t st = abort ? atomic_fetch_or(&s->state, SLOT_ABORT) : atomic_load(&s->state);
+    if (abort || (st & SLOT_ABORT)) {
+      _slot_remove_unref(s);
+    } else {
+      _slot_unref(s, 0);
+    }
+    return;
   }
 
-  int max_events = p->max_poll_events;
+  uint64_t nst, st = atomic_load_explicit(&s->state, memory_order_relaxed);
+  do {
+    nst = abort ? st | SLOT_ABORT : st;
+    if (st & SLOT_PROCESSING) {
+      nst |= _events_pack(events) << SLOT_UPDATE_SHIFT;
+    } else {
+      nst |= SLOT_PROCESSING;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(&s->state, &st, nst,
+                                                  memory_order_acq_rel, memory_order_relaxed));
+  if (st & SLOT_PROCESSING) {
+    _slot_unref(s, 0);
+    return;
+  }
 
-#if defined(IWN_KQUEUE)
-  p->stop = p->fds_count < 1;
-  struct kevent event[max_events];
-#elif defined(IWN_EPOLL)
-  _eventfd_ensure(p);
-  _timerfd_ensure(p);
-  p->stop = p->fds_count < 3;
-  struct epoll_event event[max_events];
+  s->events_processing = events;
+  atomic_store_explicit(&s->timeout_limit, INT64_MAX, memory_order_relaxed);
+
+  bool inl = reactor && _slot_is_inline(s);
+  if (IW_UNLIKELY(_stats_enabled(p))) {
+    struct stats_block *b = _stats_block(p);
+    if (b) {
+      _stats_add(inl ? &b->inline_dispatches : &b->dispatches, 1);
+    }
+    s->dispatched_us = _time_us();
+  } else {
+    s->dispatched_us = 0;
+  }
+
+  if (inl) {
+    _worker_fn(s);
+  } else if (_poller_schedule(p, _slot_prio(s), _worker_fn, s)) {
+    _slot_remove_unref(s);
+  }
+}
+
+static void _poll_event(struct iwn_poller *p, int fd, uint32_t gen, uint32_t events, bool abort) {
+  struct poller_slot *s = _slot_ref_id(p, fd, gen);
+  if (IW_LIKELY(s)) {
+#if defined(IWN_EPOLL)
+    if (s->events_mod & IWN_POLLPERSIST) {
+      events = _slot_edge_update(s, events, 0, false);
+      if (!events && !abort) { // Slot is not interested in these events right now
+        _slot_unref(s, 0);
+        return;
+      }
+    }
 #endif
+    _slot_dispatch(s, events, abort, true);
+  }
+}
 
-  if (p->flags & IWN_POLLER_POLL_NO_FDS) {
-    p->stop = false;
+/// Leaves poll loop of the current thread.
+/// The last poll thread of poller closes all polled descriptors.
+static void _poll_exit(struct iwn_poller *p) {
+  if (--p->poll_threads > 0) {
+    _poller_poke(p); // Let the next poll thread see the stop flag
+  } else {
+    _poller_cleanup(p);
   }
+}
+
+#if defined(IWN_URING)
+
+static void _poll_uring(struct iwn_poller *p) {
+  struct uring *u = p->uring;
 
   while (!p->stop) {
+    // Submit requests queued so far and wait for completions,
+    // producers of requests queued while waiting wake up the poll thread.
+    // Note: kernel waits for completions only if all `to_submit` entries are submitted.
+    atomic_store(&u->waiting, true);
+    unsigned to_submit = __atomic_load_n(u->sq_tail, __ATOMIC_ACQUIRE)
+                         - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    int rci = _uring_enter(u->fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+    atomic_store(&u->waiting, false);
+
+    if (rci == -1 && errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+      iwlog_ecode_error3(iwrc_set_errno(IW_ERROR_ERRNO, errno));
+      break;
+    }
+
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    STATS_ADD(p, polls, 1);
+    STATS_ADD(p, events, tail - head);
+    for ( ; head != tail; ++head) {
+      struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+      uint64_t data = cqe->user_data;
+      int32_t res = cqe->res;
+      uint32_t events = 0;
+      bool abort = false;
+      if (!data || res == -ECANCELED || res == -ENOENT) { // Poll remove/update or cancelled poll
+        continue;
+      }
+      if (data == URING_WAKEUP) {
+        uint64_t val;
+        while (read(u->wfd, &val, sizeof(val)) == -1 && errno == EINTR);
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+          _uring_wakeup_arm(u);
+        }
+        continue;
+      }
+      struct poller_slot *s = _slot_ref_id(p, (int) (uint32_t) data, data >> 32);
+      if (!s) {
+        continue;
+      }
+      bool more = cqe->flags & IORING_CQE_F_MORE;
+      if (!_uring_poll_done(s, (data >> 32) & 1, more)) {
+        _slot_unref(s, 0);
+        continue;
+      }
+      if (res < 0) {
+        abort = true;
+      } else {
+        events = (uint32_t) res;
+        if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+          events &= ~(EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+          abort = true;
+        }
+      }
+      if (s->events_mod & IWN_POLLET) {
+        if (!more && !abort) { // Multishot request is terminated by kernel
+          _uring_poll_arm(s, SLOT_EDGE_EVENTS);
+        }
+        events = _slot_edge_update(s, events, 0, false);
+        if (!events && !abort) {
+          _slot_unref(s, 0);
+          continue;
+        }
+      }
+      _slot_dispatch(s, events, abort, true);
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+  }
+  _poll_exit(p);
+}
+
+#endif
+
+#if defined(IWN_KQUEUE)
+typedef struct kevent poll_event_t;
+#elif defined(IWN_EPOLL)
+typedef struct epoll_event poll_event_t;
+#endif
+
+IW_INLINE int _poll_wait(struct iwn_poller *p, poll_event_t *event, int max_events, bool block) {
 #if defined(IWN_KQUEUE)
-    int nfds = kevent(p->fd, 0, 0, event, max_events, 0);
+  return kevent(p->fd, 0, 0, event, max_events, block ? 0 : &(struct timespec) { 0 });
 #elif defined(IWN_EPOLL)
-    int nfds = epoll_wait(p->fd, event, max_events, -1);
+  return epoll_wait(p->fd, event, max_events, block ? -1 : 0);
+#endif
+}
+
+/// Polls event queue without blocking for up to current busy polling budget.
+/// Budget adapts to the load: it is halved every time spinning ends without events
+/// and doubled (up to `busy_poll_us`) if events arrived shortly after the spinning is over.
+static int _poll_busy(struct iwn_poller *p, poll_event_t *event, int max_events) {
+  int nfds, budget = atomic_load_explicit(&p->busy_poll_budget, memory_order_relaxed);
+  int64_t ts = _time_us(), deadline = ts + budget;
+  if (budget > 0) {
+    do {
+      nfds = _poll_wait(p, event, max_events, false);
+      if (nfds) {
+        if (nfds > 0) {
+          STATS_ADD(p, busy_polls, 1);
+        }
+        return nfds;
+      }
+    } while (!p->stop && _time_us() < deadline);
+  }
+
+  nfds = _poll_wait(p, event, max_events, true);
+  int64_t idle = _time_us() - ts;
+  if (idle < p->busy_poll_us) {
+    budget = MIN(p->busy_poll_us, MAX(budget * 2, BUSY_POLL_MIN_US));
+  } else {
+    budget /= 2;
+  }
+  atomic_store_explicit(&p->busy_poll_budget, budget, memory_order_relaxed);
+  return nfds;
+}
+
+static void _poll(struct iwn_poller *p) {
+  int max_events = p->max_poll_events;
+  _affinity_ensure(p);
+  _thread_poller = p;
+
+#if defined(IWN_URING)
+  if (p->uring) {
+    _poll_uring(p);
+    return;
+  }
 #endif
+
+  poll_event_t event[max_events];
+
+  while (!p->stop) {
+    int nfds = p->busy_poll_us
+               ? _poll_busy(p, event, max_events)
+               : _poll_wait(p, event, max_events, true);
+    STATS_ADD(p, polls, 1);
     if (nfds < 0) {
       if (errno != EINTR) {
         iwlog_ecode_error3(iwrc_set_errno(IW_ERROR_ERRNO, errno));
@@ -997,9 +2771,10 @@ void iwn_poller_poll(struct iwn_poller *p) {
         continue;
       }
     }
+    STATS_ADD(p, events, nfds);
     for (int i = 0; i < nfds; ++i) {
       int fd;
-      uint32_t events = 0;
+      uint32_t events = 0, gen = 0;
       bool abort = false;
 
 #if defined(IWN_KQUEUE)
@@ -1009,10 +2784,9 @@ void iwn_poller_poll(struct iwn_poller *p) {
       fd = (int) event[i].ident;
       if (fd == p->fd) { // Own, not fd related event
         if (event[i].filter == EVFILT_TIMER) {
-          if (__sync_bool_compare_and_swap(&p->housekeeping, false, true)) {
-            _timer_ready_impl(p);
-            __sync_bool_compare_and_swap(&p->housekeeping, true, false);
-          }
+          _timer_ready_impl(p);
+        } else if (event[i].filter == EVFILT_USER) {
+          _cmd_drain(p);
         }
         continue;
       }
@@ -1029,7 +2803,8 @@ void iwn_poller_poll(struct iwn_poller *p) {
       }
 
 #elif defined(IWN_EPOLL)
-      fd = event[i].data.fd;
+      fd = (int) (uint32_t) event[i].data.u64;
+      gen = event[i].data.u64 >> 32;
       events = event[i].events;
       if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
         events &= ~(EPOLLRDHUP | EPOLLHUP | EPOLLERR);
@@ -1037,54 +2812,108 @@ void iwn_poller_poll(struct iwn_poller *p) {
       }
 #endif
 
-      struct poller_slot *s = _slot_ref_id(p, fd, REF_SET_LOCKED);
-      if (IW_UNLIKELY(!s)) {
-        pthread_mutex_unlock(&p->mtx);
-        if (abort) {
-          iwn_poller_remove(p, fd);
-        }
-        continue;
-      } else if (IW_UNLIKELY(!events)) {
-        bool destroy = _slot_unref(s, REF_LOCKED);
-        if (abort) {
-          s->abort = true;
-        } else {
-          abort = s->abort;
-        }
-        pthread_mutex_unlock(&p->mtx);
-        if (destroy) {
-          _slot_destroy(s);
-        } else if (abort) {
-          iwn_poller_remove(p, fd);
-        }
-        continue;
-      } else if (s->flags & SLOT_PROCESSING) {
-        if (abort) {
-          s->abort = true;
-        }
-        s->events_update |= events;
-        bool destroy = _slot_unref(s, REF_LOCKED);
-        pthread_mutex_unlock(&p->mtx);
-        if (destroy) {
-          _slot_destroy(s);
-        }
-        continue;
-      } else {
-        if (abort) {
-          s->abort = true;
-        }
-        s->flags |= SLOT_PROCESSING;
-        s->events_update = 0;
-        s->events_processing = events;
-        s->timeout_limit = INT_MAX;
-      }
-      pthread_mutex_unlock(&p->mtx);
+      _poll_event(p, fd, gen, events, abort);
+    }
+  }
+  _poll_exit(p);
+}
 
-      if (iwtp_schedule(p->tp, _worker_fn, s)) {
-        _slot_remove_unref(p, fd);
+struct poll_thread {
+  struct iwn_poller *p;
+  char *name;
+};
+
+static void* _poll_thread_worker(void *d) {
+  struct poll_thread *pt = d;
+  struct iwn_poller *p = pt->p;
+  if (pt->name) {
+    iwp_set_current_thread_name(pt->name);
+    free(pt->name);
+  }
+  free(pt);
+  _poll(p);
+  return 0;
+}
+
+/// Starts extra poll thread of the given poller `shard`.
+static iwrc _poll_thread_start(struct iwn_poller *shard, const char *thread_name, int thr, pthread_t *out_thr) {
+  iwrc rc = 0;
+  struct poll_thread *pt = calloc(1, sizeof(*pt));
+  RCB(finish, pt);
+  pt->p = shard;
+  if (thread_name) {
+    char buf[64];
+    if (shard->root->num_shards == 0) {
+      snprintf(buf, sizeof(buf), "%s-%d", thread_name, thr);
+    } else if (thr == 0) {
+      snprintf(buf, sizeof(buf), "%s-%d", thread_name, shard->idx);
+    } else {
+      snprintf(buf, sizeof(buf), "%s-%d-%d", thread_name, shard->idx, thr);
+    }
+    pt->name = strdup(buf);
+  }
+  int rci = pthread_create(out_thr, 0, _poll_thread_worker, pt);
+  if (rci) {
+    rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+  }
+
+finish:
+  if (rc && pt) {
+    free(pt->name);
+    free(pt);
+  }
+  return rc;
+}
+
+void iwn_poller_poll(struct iwn_poller *p) {
+  p = p->root;
+  char *thread_name = p->thread_name;
+  if (thread_name) {
+    iwp_set_current_thread_name(thread_name);
+    p->thread_name = 0;
+  }
+
+  bool stop = !(p->flags & IWN_POLLER_POLL_NO_FDS) && !_poller_has_fds(p);
+  struct iwn_poller **shards = p->num_shards ? p->shards : &p;
+  int num_shards = p->num_shards ? p->num_shards : 1;
+  int nthr = 0, max_threads = 0;
+
+  p->stop = stop;
+  for (int i = 0; i < num_shards; ++i) {
+    struct iwn_poller *shard = shards[i];
+    shard->stop = stop;
+    shard->poll_threads = shard->num_poll_threads;
+    max_threads += shard->num_poll_threads;
+#if defined(IWN_EPOLL)
+    _eventfd_ensure(shard);
+    _timerfd_ensure(shard);
+#endif
+  }
+
+  // Every shard is polled by `num_poll_threads` threads,
+  // the first poll thread of the first shard is the current thread.
+  iwrc rc = 0;
+  pthread_t threads[max_threads];
+  for (int i = 0; i < num_shards; ++i) {
+    struct iwn_poller *shard = shards[i];
+    for (int j = (i == 0); j < shard->num_poll_threads; ++j) {
+      if (!rc) {
+        rc = _poll_thread_start(shard, thread_name, j, &threads[nthr]);
+        if (!rc) {
+          ++nthr;
+          continue;
+        }
+        iwlog_ecode_error3(rc);
+        iwn_poller_shutdown_request(p);
       }
+      _poll_exit(shard); // Thread is not started
     }
   }
-  // Close all polled descriptors
-  _poller_cleanup(p);
+
+  _poll(shards[0]);
+
+  for (int i = 0; i < nthr; ++i) {
+    pthread_join(threads[i], 0);
+  }
+  free(thread_name);
 }
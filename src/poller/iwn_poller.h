@@ -21,8 +21,40 @@ IW_EXTERN_C_START
 
 /// Poller will do oneshot execution of `on_ready()` handler
 /// after the period of time in milliseconds specified in `iwn_poller_task::timeout` field.
+/// Timer tasks don't consume file descriptors, they are identified by negative handles
+/// returned by iwn_poller_add2() and can be cancelled by iwn_poller_remove().
+/// If `on_ready()` returns a positive number the task fires again after that number of milliseconds.
 #define IWN_POLLTIMEOUT (1U << 21)
 
+/// Slot `on_ready()` handler is executed directly by the poller reactor thread
+/// rather than by worker threads pool. Handler must be short and must not block.
+/// Applicable to iwn_poller_task::events_mod
+#define IWN_POLLINLINE (1U << 22)
+
+/// Slot `on_ready()` handler may block, it is always executed by worker threads pool
+/// even if poller has IWN_POLLER_INLINE flag set.
+/// Applicable to iwn_poller_task::events_mod
+#define IWN_POLLBLOCKING (1U << 23)
+
+/// Slot fd is registered once with edge triggered events of both directions
+/// and its readiness is tracked by the poller, so rearm of slot events
+/// costs no `epoll_ctl()` syscall. Implies IWN_POLLET.
+/// Ready events are kept and dispatched again on every rearm until read/write of slot fd
+/// returns `EAGAIN` and it is reported by iwn_poller_edge_drained().
+/// Poller adapters report it on their own.
+/// Applicable to iwn_poller_task::events_mod
+#define IWN_POLLPERSIST (1U << 24)
+
+/// Slot `on_ready()` handler is executed in the high priority lane,
+/// see iwn_poller_spec::num_priority_threads. Suitable for listener accept and other short handlers.
+/// Applicable to iwn_poller_task::events_mod
+#define IWN_POLLPRIO (1U << 25)
+
+/// Slot `on_ready()` handler is executed in the background lane,
+/// see iwn_poller_spec::num_background_threads.
+/// Applicable to iwn_poller_task::events_mod
+#define IWN_POLLBACKGROUND (1U << 26)
+
 #ifdef __linux__
 #define IWN_EPOLL
 #include <sys/epoll.h>
@@ -30,18 +62,68 @@ IW_EXTERN_C_START
 #define IWN_POLLOUT     EPOLLOUT
 #define IWN_POLLONESHOT EPOLLONESHOT
 #define IWN_POLLET      EPOLLET
+#define IWN_POLLEXCLUSIVE EPOLLEXCLUSIVE
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define IWN_URING
+#endif
+#endif
 #elif defined(IWN_KQUEUE)
 #define IWN_POLLIN      0x01U
 #define IWN_POLLOUT     0x02U
 #define IWN_POLLONESHOT 0x04U
 #define IWN_POLLET      0x08U
+#define IWN_POLLEXCLUSIVE 0
 #else
 #error "Unsupported operating system"
 #endif
 
+/// @def IWN_POLLEXCLUSIVE
+/// Wake up only one of the waiters when the same fd (eg: listen socket) is registered
+/// in several pollers or poller shards. Applicable to iwn_poller_task::events_mod.
+/// Must be used with IWN_POLLET, `on_ready()` handler should consume events until `EAGAIN`.
+/// Slot events are fixed at fd registration, subsequent rearms are no-op.
+/// Ignored by kqueue and io_uring backends.
+
 /// Start poller loop even with no managed fds.
 #define IWN_POLLER_POLL_NO_FDS 0x01U
 
+/// Use io_uring instead of epoll to poll events (Linux 5.13+).
+/// Poller falls back to epoll if io_uring is not available.
+/// Note: `IWN_POLLET` fds are polled persistently so rearm of them costs no syscall,
+/// their `on_ready` handlers should read/write until `EAGAIN`.
+/// Applicable only to iwn_poller_spec::flags
+#define IWN_POLLER_URING 0x02U
+
+/// Execute `on_ready()` handlers of all slots except IWN_POLLBLOCKING ones
+/// directly by the poller reactor thread, see IWN_POLLINLINE.
+#define IWN_POLLER_INLINE 0x04U
+
+/// Use work stealing thread pool instead of shared queue one to execute slot handlers and tasks.
+/// Every worker has its own queue, consecutive events of the same fd tend to be processed
+/// by the same worker, idle workers steal tasks from busy ones.
+/// iwn_poller_spec::overflow_threads_factor is not applicable in this mode.
+/// Applicable only to iwn_poller_spec::flags
+#define IWN_POLLER_WORK_STEALING 0x08U
+
+/// Pin poll and worker threads of every shard to cpu cores of a single NUMA node,
+/// shards are distributed over NUMA nodes round-robin. So buffers allocated by slot handlers
+/// are local to the node serving the fd (first touch policy of OS memory allocator).
+/// If iwn_poller_spec::cpus is set only these cores are used. Linux only.
+/// Applicable only to iwn_poller_spec::flags
+#define IWN_POLLER_NUMA 0x10U
+
+/// Collect runtime statistics of poller, see iwn_poller_stats().
+/// Can be toggled at runtime by iwn_poller_flags_set().
+#define IWN_POLLER_STATS 0x20U
+
+/// iwn_poller_arm_events() and iwn_poller_remove() called by threads other than
+/// poller's own poll and worker threads are put into lock-free command queue of poller shard
+/// and executed by the poller in batches, a single wakeup per batch.
+/// Queued iwn_poller_arm_events() errors are logged rather than returned.
+/// Applicable only to iwn_poller_spec::flags
+#define IWN_POLLER_CMD_QUEUE 0x40U
+
 /// @}
 
 struct iwn_poller;
@@ -57,7 +139,9 @@ struct iwn_poller_task {
   long     timeout;                                              ///< Max event channel inactivity timeout in seconds.
                                                                  ///  Or timeout in milliseconds in IWN_POLLTIMEOUT
                                                                  ///  mode.
-  struct iwn_poller *poller;                                     ///< Poller
+  struct iwn_poller *poller;                                     ///< Poller. In sharded mode handlers receive
+                                                                 ///  a poller shard serving the fd,
+                                                                 ///  it is accepted by any poller API function.
 };
 
 struct iwn_poller_spec {
@@ -80,11 +164,96 @@ struct iwn_poller_spec {
 
   /// Poller operational flags.
   /// Bitmask of following:
-  ///   - IWN_POLLER_POLL_NO_FDS 
+  ///   - IWN_POLLER_POLL_NO_FDS
+  ///   - IWN_POLLER_URING
+  ///   - IWN_POLLER_INLINE
+  ///   - IWN_POLLER_WORK_STEALING
+  ///   - IWN_POLLER_NUMA
+  ///   - IWN_POLLER_STATS
+  ///   - IWN_POLLER_CMD_QUEUE
   unsigned flags;
 
   /// @see iwtp_spec::warn_on_overflow_thread_spawn
   bool warn_on_overflow_thread_spawn;
+
+  /// Number of independent reactors (shards) poller consists of.
+  /// Each shard has its own event queue, slots, timer and worker threads.
+  /// Managed fd is pinned to the shard `fd % num_shards` for its lifetime.
+  /// `num_threads` are evenly distributed between shards, `queue_limit` is applied per shard.
+  /// Number of cpu cores if negative.
+  /// Default: 0 (single reactor), Max: 256
+  int num_shards;
+
+  /// Number of threads polling events of each shard (leader/follower).
+  /// Every poll thread handles the events it has harvested itself,
+  /// `iwn_poller_poll()` spawns extra poll threads and waits for them.
+  /// io_uring shards are always polled by a single thread.
+  /// Default: 1, Max: 64
+  int num_poll_threads;
+
+  /// Optional array of cpu cores poll and worker threads are pinned to.
+  /// Cores are distributed between shards round-robin, so every shard gets its own subset of cores
+  /// if `num_cpus` is not less than `num_shards`. See also IWN_POLLER_NUMA. Linux only.
+  /// Note: the thread called iwn_poller_poll() is pinned as well.
+  const int *cpus;
+
+  /// Number of elements in `cpus` array.
+  int num_cpus;
+
+  /// Max time in microseconds poll threads spin polling event queue
+  /// without blocking before falling into blocking wait. Trades cpu time for wakeup latency.
+  /// Actual spin time adapts to the load: it shrinks when events do not arrive
+  /// within the budget and grows back when they do. Not applicable to io_uring shards.
+  /// Default: 0 (disabled), Max: 100000
+  int busy_poll_us;
+
+  /// Number of threads of high priority lane, see IWN_POLLER_PRIO_HIGH.
+  /// Threads are evenly distributed between shards.
+  /// Default: 0 (lane is served by `num_threads` workers), Max: 1024
+  int num_priority_threads;
+
+  /// Number of threads of background lane, see IWN_POLLER_PRIO_BACKGROUND.
+  /// Threads are evenly distributed between shards.
+  /// Default: 0 (lane is served by `num_threads` workers), Max: 1024
+  int num_background_threads;
+};
+
+/// Priority classes (lanes) of work executed by poller worker threads.
+/// High priority and background lanes have their own worker threads if configured by
+/// iwn_poller_spec::num_priority_threads and iwn_poller_spec::num_background_threads,
+/// otherwise they share the normal lane threads.
+#define IWN_POLLER_PRIO_NORMAL     0 ///< Fd event handlers and iwn_poller_task() tasks
+#define IWN_POLLER_PRIO_HIGH       1 ///< Latency critical short handlers, eg: accept of connections
+#define IWN_POLLER_PRIO_BACKGROUND 2 ///< Bulk background jobs
+
+/// Number of buckets in iwn_poller_histogram.
+#define IWN_POLLER_HISTOGRAM_BUCKETS 24
+
+/// Latency histogram in microseconds.
+/// Bucket `i` counts values in range `[2^i, 2^(i+1))`, the first bucket also counts zero values
+/// and the last one counts all values above its lower bound.
+struct iwn_poller_histogram {
+  uint64_t count;  ///< Number of values
+  uint64_t sum;    ///< Sum of values
+  uint64_t max;    ///< Max value
+  uint64_t buckets[IWN_POLLER_HISTOGRAM_BUCKETS];
+};
+
+/// Poller runtime statistics collected since poller creation while IWN_POLLER_STATS flag is set.
+struct iwn_poller_stats {
+  uint64_t polls;             ///< Number of poll calls (epoll_wait, kevent, io_uring_enter) returned
+  uint64_t events;            ///< Number of events harvested by poll calls
+  uint64_t dispatches;        ///< Number of slot handler executions scheduled to worker threads
+  uint64_t inline_dispatches; ///< Number of slot handler executions by poll threads
+  uint64_t updates;           ///< Number of handler re-executions for events received while slot was processing
+  uint64_t rearms;            ///< Number of slot events rearms
+  uint64_t timeouts;          ///< Number of expired slot timeouts and fired timer tasks
+  uint64_t busy_polls;        ///< Number of poll calls returned events while busy polling
+  uint64_t commands;          ///< Number of executed commands queued by foreign threads, see IWN_POLLER_CMD_QUEUE
+  int      fds;               ///< Number of managed fds and timer tasks at the moment
+  int      queue_size;        ///< Number of pending tasks of worker threads at the moment
+  struct iwn_poller_histogram dispatch_delay; ///< Delay between event is harvested and its handler is started
+  struct iwn_poller_histogram handler_time;   ///< Slot handler run time
 };
 
 /// Function executed in context of polled file descriptor.
@@ -110,6 +279,8 @@ IW_EXPORT iwrc iwn_poller_create(int num_threads, int one_shot_events, struct iw
 /// Registers polling fd task.
 IW_EXPORT iwrc iwn_poller_add(const struct iwn_poller_task *task);
 
+/// Registers polling fd task and returns its fd in `out_fd`.
+/// For IWN_POLLTIMEOUT tasks `out_fd` is a negative timer handle (less than -1).
 IW_EXPORT iwrc iwn_poller_add2(const struct iwn_poller_task *task, int *out_fd);
 
 /// Returns true if the given `fd` managed by poller.
@@ -120,6 +291,10 @@ IW_EXPORT bool iwn_poller_fd_ref(struct iwn_poller*, int fd, int refs);
 /// Activates a set of `events` defined by @ref iwn_poller_flags on managed `fd`.
 IW_EXPORT iwrc iwn_poller_arm_events(struct iwn_poller*, int fd, uint32_t events);
 
+/// Reports that read (IWN_POLLIN) or write (IWN_POLLOUT) `events` of IWN_POLLPERSIST slot `fd`
+/// are exhausted, eg: read() or write() returned `EAGAIN`. No-op for other slots.
+IW_EXPORT void iwn_poller_edge_drained(struct iwn_poller*, int fd, uint32_t events);
+
 /// Set timeout for polled file descriptor.
 IW_EXPORT void iwn_poller_set_timeout(struct iwn_poller*, int fd, long timeout_sec);
 
@@ -139,8 +314,14 @@ IW_EXPORT void iwn_poller_destroy(struct iwn_poller **pp);
 /// Submits a poller task to the given poller.
 IW_EXPORT iwrc iwn_poller_task(struct iwn_poller*, void (*task)(void*), void *arg);
 
+/// Submits a poller task to the lane of given priority `prio`.
+/// @param prio One of IWN_POLLER_PRIO_NORMAL, IWN_POLLER_PRIO_HIGH, IWN_POLLER_PRIO_BACKGROUND.
+IW_EXPORT iwrc iwn_poller_task_prio(struct iwn_poller*, void (*task)(void*), void *arg, int prio);
+
 /// Set one of the following poller flags:
 /// - IWN_POLLER_POLL_NO_FDS - Start poller loop even with no managed fds.
+/// - IWN_POLLER_INLINE - Execute non blocking slot handlers by the reactor thread.
+/// - IWN_POLLER_STATS - Collect runtime statistics.
 //
 IW_EXPORT void iwn_poller_flags_set(struct iwn_poller*, uint32_t flags);
 
@@ -151,6 +332,16 @@ IW_EXPORT void iwn_poller_poll(struct iwn_poller*);
 /// Starts poller poll event loop in separate thread.
 IW_EXPORT iwrc iwn_poller_poll_in_thread(struct iwn_poller*, const char *thr_name, pthread_t *out_thr);
 
+/// Fills `stats` with runtime statistics summed over all poller shards and threads.
+/// Counters are updated only while IWN_POLLER_STATS poller flag is set.
+IW_EXPORT void iwn_poller_stats(struct iwn_poller*, struct iwn_poller_stats *stats);
+
+/// Returns number of tasks pending execution by worker threads of all poller shards and lanes.
+IW_EXPORT int iwn_poller_queue_size(struct iwn_poller*);
+
+/// Returns `true` if poller polls events by io_uring.
+IW_EXPORT bool iwn_poller_uses_uring(struct iwn_poller*);
+
 /// Returns `true` if poller event loop is alive.
 IW_EXPORT bool iwn_poller_alive(struct iwn_poller*);
 
@@ -5,6 +5,8 @@
 
 #include "iwn_poller.h"
 
+#include <sys/uio.h>
+
 IW_EXTERN_C_START
 
 struct iwn_poller_adapter;
@@ -21,6 +23,8 @@ struct iwn_poller_adapter {
   bool    (*has_pending_write_bytes)(struct iwn_poller_adapter *a);
   void   *user_data;
   int     fd;
+  /// Gather write, may be zero if adapter doesn't support it.
+  ssize_t (*writev)(struct iwn_poller_adapter *a, const struct iovec *iov, int iovcnt);
 };
 
 IW_EXTERN_C_END
@@ -1,3 +1,6 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // splice()
+#endif
 #include "iwn_proc.h"
 #include "iwn_scheduler.h"
 
@@ -17,15 +20,27 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
+#if defined(SYS_pidfd_open)
+#define HAVE_PIDFD
+#endif
+#else
+#include <spawn.h>
 #endif
 
 #define FDS_STDOUT 0
 #define FDS_STDERR 1
 #define FDS_STDIN  2
 
+#define READ_BUF_SIZE_DEFAULT 65536
+#define SPAWN_STACK_SIZE      131072
+
 struct proc {
   pid_t pid;
   int   wstatus;
@@ -39,13 +54,19 @@ struct proc {
   IWXSTR *buf_stdin;
   struct iwn_proc_spec spec;
   int fds[3]; // {stdout, stderr, stdin}
+  char  *rbuf[2];     // Read buffers of {stdout, stderr}
+  size_t rbuf_len[2]; // Number of pending bytes in read buffers
+  size_t rbuf_size;
+  bool   nosplice[2]; // Forwarding of {stdout, stderr} doesn't support splice()
   pthread_mutex_t mtx;
   bool exited;
 };
 
 static struct  {
   IWHMAP *map;  ///< Proc: pid -> struct *_proc
-  IWSTW   stw;  ///< Child process wait worker
+  IWSTW   stw;  ///< Child process wait worker, used if pidfd is not available
+  IWHMAP *reaped; ///< Pid -> wstatus + 1 of children reaped by wait worker before registration
+  int     spawns; ///< Number of spawns in flight, reaped unknown children are kept only while it is not zero
   pthread_mutex_t mtx;
   pthread_cond_t  cond;
 } cc = {
@@ -77,9 +98,6 @@ static iwrc _init_lk(void) {
   if (!cc.map) {
     RCB(finish, cc.map = iwhmap_create_u32(_kv_free));
   }
-  if (!cc.stw) {
-    rc = iwstw_start("proc_stw", 0, false, &cc.stw);
-  }
 
 finish:
   return rc;
@@ -123,6 +141,7 @@ static void _proc_unref(pid_t pid, int wstatus) {
   proc->refs--;
   if (wstatus != -1) {
     proc->wstatus = wstatus;
+    proc->exited = true;
   }
   if (proc->refs > 0) {
     pthread_mutex_unlock(&cc.mtx);
@@ -157,18 +176,147 @@ void iwn_proc_unref(pid_t pid) {
   _proc_unref(pid, -1);
 }
 
+static void _proc_reaped(pid_t pid, int wstatus) {
+  pthread_mutex_lock(&cc.mtx);
+  struct proc *proc = cc.map ? iwhmap_get_u32(cc.map, pid) : 0;
+  if (!proc) {
+    // Child may have exited before iwn_proc_spawn() registered it.
+    // Children not spawned by us (eg: by system()) are ignored.
+    if (cc.spawns > 0) {
+      if (!cc.reaped) {
+        cc.reaped = iwhmap_create_u32(0);
+      }
+      if (cc.reaped) {
+        iwhmap_put_u32(cc.reaped, pid, (void*) (intptr_t) (wstatus + 1));
+      }
+    }
+    pthread_mutex_unlock(&cc.mtx);
+    return;
+  }
+  pthread_mutex_unlock(&cc.mtx);
+  _proc_unref(pid, wstatus);
+}
+
+static void _proc_reaped_apply(pid_t pid) {
+  intptr_t v = 0;
+  pthread_mutex_lock(&cc.mtx);
+  if (cc.reaped) {
+    v = (intptr_t) iwhmap_get_u32(cc.reaped, pid);
+    if (v) {
+      iwhmap_remove_u32(cc.reaped, pid);
+    }
+  }
+  pthread_mutex_unlock(&cc.mtx);
+  if (v) {
+    _proc_unref(pid, (int) (v - 1));
+  }
+}
+
+/// Marks start of child spawn.
+static void _proc_spawn_begin(void) {
+  pthread_mutex_lock(&cc.mtx);
+  ++cc.spawns;
+  pthread_mutex_unlock(&cc.mtx);
+}
+
+/// Marks end of child spawn started by _proc_spawn_begin().
+/// Reaped children left unclaimed when no spawns are in flight are dropped.
+static void _proc_spawn_end(void) {
+  pthread_mutex_lock(&cc.mtx);
+  if (--cc.spawns == 0 && cc.reaped) {
+    iwhmap_clear(cc.reaped);
+  }
+  pthread_mutex_unlock(&cc.mtx);
+}
+
 static void _proc_wait_worker(void *arg) {
-  while (cc.map) { // FIXME
+  while (1) {
     int wstatus = 0;
     pid_t pid = wait(&wstatus);
-    if (pid != -1) { // No child processes or shutdown
-      _proc_unref(pid, wstatus);
-    } else {
+    if (pid != -1) {
+      _proc_reaped(pid, wstatus);
+    } else if (errno != EINTR) { // No child processes
       return;
     }
   }
 }
 
+static iwrc _proc_wait_worker_start(void) {
+  iwrc rc = 0;
+  bool bv;
+  pthread_mutex_lock(&cc.mtx);
+  if (!cc.stw) {
+    rc = iwstw_start("proc_stw", 0, false, &cc.stw);
+  }
+  pthread_mutex_unlock(&cc.mtx);
+  if (!rc) {
+    rc = iwstw_schedule_empty_only(cc.stw, _proc_wait_worker, 0, &bv);
+  }
+  return rc;
+}
+
+#ifdef HAVE_PIDFD
+
+static bool _proc_exited(pid_t pid) {
+  pthread_mutex_lock(&cc.mtx);
+  struct proc *proc = cc.map ? iwhmap_get_u32(cc.map, pid) : 0;
+  bool ret = !proc || proc->refs == 0 || proc->exited;
+  pthread_mutex_unlock(&cc.mtx);
+  return ret;
+}
+
+static int64_t _on_pidfd_ready(const struct iwn_poller_task *t, uint32_t flags) {
+  pid_t pid = (pid_t) (intptr_t) t->user_data;
+  pid_t rpid;
+  int wstatus = 0;
+  while ((rpid = waitpid(pid, &wstatus, WNOHANG)) == -1 && errno == EINTR);
+  if (rpid == 0) {
+    return 0; // Still alive
+  }
+  if (rpid == pid) {
+    _proc_unref(pid, wstatus);
+  } // Otherwise child has been reaped by the wait worker
+  return -1;
+}
+
+static void _on_pidfd_dispose(const struct iwn_poller_task *t) {
+  pid_t pid = (pid_t) (intptr_t) t->user_data;
+  if (!_proc_exited(pid)) {
+    // Poller is gone before child exit, reap it by the wait worker
+    iwrc rc = _proc_wait_worker_start();
+    if (rc) {
+      iwlog_ecode_error3(rc);
+    }
+  }
+}
+
+/// Watches child exit by pidfd in the poller.
+/// Returns `false` if pidfd is not supported by the running kernel.
+static bool _proc_pidfd_watch(struct iwn_poller *poller, pid_t pid) {
+  iwrc rc;
+  int fd = (int) syscall(SYS_pidfd_open, pid, 0);
+  if (fd == -1) {
+    return false;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  rc = iwn_poller_add(&(struct iwn_poller_task) {
+    .fd = fd,
+    .user_data = (void*) (intptr_t) pid,
+    .on_ready = _on_pidfd_ready,
+    .on_dispose = _on_pidfd_dispose,
+    .events = IWN_POLLIN,
+    .poller = poller
+  });
+  if (rc) {
+    iwlog_ecode_error3(rc);
+    close(fd);
+    return false;
+  }
+  return true;
+}
+
+#endif
+
 static struct proc* _proc_create(const struct iwn_proc_spec *spec) {
   IWPOOL *pool = iwpool_create(sizeof(struct proc));
   if (!pool) {
@@ -239,15 +387,19 @@ static iwrc _proc_init(struct proc *proc, int fds[6]) {
     proc->envp = 0;
   }
 
-  if (spec->on_stdout) {
+  proc->rbuf_size = spec->read_buf_size > 0 ? spec->read_buf_size : READ_BUF_SIZE_DEFAULT;
+
+  if (spec->on_stdout || spec->forward_stdout_fd > 0) {
     RCN(finish, pipe(&fds[0]));
     proc->fds[FDS_STDOUT] = fds[0];
     RCC(rc, finish, _make_non_blocking(fds[0]));
+    RCB(finish, proc->rbuf[FDS_STDOUT] = iwpool_alloc(proc->rbuf_size, pool));
   }
-  if (spec->on_stderr) {
+  if (spec->on_stderr || spec->forward_stderr_fd > 0) {
     RCN(finish, pipe(&fds[2]));
     proc->fds[FDS_STDERR] = fds[2];
     RCC(rc, finish, _make_non_blocking(fds[2]));
+    RCB(finish, proc->rbuf[FDS_STDERR] = iwpool_alloc(proc->rbuf_size, pool));
   }
   if (spec->write_stdin) {
     RCN(finish, pipe(&fds[4]));
@@ -259,27 +411,54 @@ finish:
   return rc;
 }
 
-static int64_t _on_ready(
-  const struct iwn_poller_task *t,
-  uint32_t                      flags,
-  int                           fdi
-  ) {
-  iwrc rc = 0;
-  int64_t ret = 0;
-  int fd = t->fd;
-  pid_t pid = (pid_t) (intptr_t) t->user_data;
-  struct proc *proc = _proc_ref(pid);
+static void _proc_output(struct proc *proc, int fdi, const char *buf, size_t len) {
+  if (fdi == FDS_STDERR) {
+    proc->spec.on_stderr((void*) proc, buf, len);
+  } else if (fdi == FDS_STDOUT) {
+    proc->spec.on_stdout((void*) proc, buf, len);
+  }
+}
 
-  if (!proc) {
-    return -1;
+/// Passes read buffer data to the output callback,
+/// incomplete trailing line is kept in buffer unless `flush` is set.
+static void _proc_output_flush(struct proc *proc, int fdi, bool flush) {
+  char *buf = proc->rbuf[fdi];
+  size_t len = proc->rbuf_len[fdi], off = 0;
+
+  if (proc->spec.output_lines) {
+    char *nl;
+    while (off < len && (nl = memchr(buf + off, '\n', len - off))) {
+      _proc_output(proc, fdi, buf + off, nl - buf - off);
+      off = nl - buf + 1;
+    }
+    if (off == 0 && len == proc->rbuf_size) {
+      flush = true; // Line doesn't fit into buffer
+    }
+  } else {
+    flush = true;
+  }
+  if (flush && off < len) {
+    _proc_output(proc, fdi, buf + off, len - off);
+    off = len;
   }
+  if (off > 0 && off < len) {
+    memmove(buf, buf + off, len - off);
+  }
+  proc->rbuf_len[fdi] = len - off;
+}
 
-  IWXSTR *xstr;
-  RCB(finish, xstr = iwxstr_new());
+static int64_t _proc_read(struct proc *proc, int fd, int fdi) {
+  iwrc rc = 0;
+  int64_t ret = 0;
+  char *buf = proc->rbuf[fdi];
 
-  while (!rc) {
-    char buf[1024];
-    ssize_t rci = read(fd, buf, sizeof(buf));
+  while (1) {
+    size_t len = proc->rbuf_len[fdi];
+    if (len == proc->rbuf_size) {
+      _proc_output_flush(proc, fdi, false);
+      continue;
+    }
+    ssize_t rci = read(fd, buf + len, proc->rbuf_size - len);
     if (rci == -1) {
       if (errno == EINTR) {
         continue;
@@ -292,24 +471,91 @@ static int64_t _on_ready(
       ret = -1;
       break;
     }
-    rc = iwxstr_cat(xstr, buf, rci);
+    proc->rbuf_len[fdi] += rci;
+  }
+
+  _proc_output_flush(proc, fdi, ret == -1 || rc);
+  if (rc) {
+    iwlog_ecode_error3(rc);
+    ret = -1;
+  }
+  return ret;
+}
+
+static int64_t _proc_forward(struct proc *proc, int fd, int fdi) {
+  iwrc rc = 0;
+  int ofd = fdi == FDS_STDERR ? proc->spec.forward_stderr_fd : proc->spec.forward_stdout_fd;
+
+#ifdef __linux__
+  while (!proc->nosplice[fdi]) {
+    ssize_t rci = splice(fd, 0, ofd, 0, proc->rbuf_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (rci > 0) {
+      continue;
+    } else if (rci == 0) {
+      return -1;
+    } else if (errno == EINTR) {
+      continue;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return 0;
+    } else if (errno == EINVAL) {
+      proc->nosplice[fdi] = true; // Target doesn't support splice, eg: file opened with O_APPEND
+    } else {
+      rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+      goto finish;
+    }
   }
+#endif
 
-  if (iwxstr_size(xstr) > 0) {
-    if (fdi == FDS_STDERR) {
-      proc->spec.on_stderr((void*) proc, iwxstr_ptr(xstr), iwxstr_size(xstr));
-    } else if (fdi == FDS_STDOUT) {
-      proc->spec.on_stdout((void*) proc, iwxstr_ptr(xstr), iwxstr_size(xstr));
+  while (1) {
+    ssize_t rci = read(fd, proc->rbuf[fdi], proc->rbuf_size);
+    if (rci == -1) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+      goto finish;
+    } else if (rci == 0) {
+      return -1;
+    }
+    for (ssize_t off = 0, wci; off < rci; off += wci) {
+      wci = write(ofd, proc->rbuf[fdi] + off, rci - off);
+      if (wci == -1) {
+        if (errno == EINTR) {
+          wci = 0;
+          continue;
+        }
+        rc = iwrc_set_errno(IW_ERROR_IO_ERRNO, errno);
+        goto finish;
+      }
     }
   }
 
 finish:
-  iwxstr_destroy(xstr);
-  if (rc) {
-    iwlog_ecode_error3(rc);
+  iwlog_ecode_error(rc, "proc | Failed to forward output of %d", proc->pid);
+  return -1;
+}
+
+static int64_t _on_ready(
+  const struct iwn_poller_task *t,
+  uint32_t                      flags,
+  int                           fdi
+  ) {
+  int64_t ret;
+  pid_t pid = (pid_t) (intptr_t) t->user_data;
+  struct proc *proc = _proc_ref(pid);
+
+  if (!proc) {
+    return -1;
+  }
+  if ((fdi == FDS_STDERR ? proc->spec.forward_stderr_fd : proc->spec.forward_stdout_fd) > 0) {
+    ret = _proc_forward(proc, t->fd, fdi);
+  } else {
+    ret = _proc_read(proc, t->fd, fdi);
   }
   _proc_unref(pid, -1);
-  return rc ? -1 : ret;
+  return ret;
 }
 
 static void _on_fd_dispose(const struct iwn_poller_task *t) {
@@ -548,6 +794,196 @@ iwrc iwn_proc_kill_ensure(struct iwn_poller *poller, pid_t pid, int signum, int
   return rc;
 }
 
+/// Resolves path of executable to be spawned by `exec()` without `PATH` lookup.
+/// If `find_executable_in_path` is set the executable is searched like execvp() does
+/// using `PATH` of the child environment.
+static iwrc _proc_exec_path(struct proc *proc, const char **out_path) {
+  const char *name = proc->path;
+  *out_path = name;
+  if (!proc->spec.find_executable_in_path || strchr(name, '/')) {
+    return 0;
+  }
+  const char *path = 0;
+  if (proc->envp) {
+    for (char **ep = proc->envp; *ep; ++ep) {
+      if (strncmp(*ep, "PATH=", IW_LLEN("PATH=")) == 0) {
+        path = *ep + IW_LLEN("PATH=");
+        break;
+      }
+    }
+  } else {
+    path = getenv("PATH");
+  }
+  if (!path) {
+    path = "/bin:/usr/bin";
+  }
+  size_t nlen = strlen(name);
+  char *buf = iwpool_alloc(strlen(path) + nlen + 2, proc->pool);
+  if (!buf) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  int err = ENOENT;
+  for (const char *p = path, *e; ; p = e + 1) {
+    struct stat st;
+    size_t len = 0;
+    e = strchr(p, ':');
+    if (!e) {
+      e = p + strlen(p);
+    }
+    if (e > p) { // Empty element of PATH is the current directory
+      len = e - p;
+      memcpy(buf, p, len);
+      buf[len++] = '/';
+    }
+    memcpy(buf + len, name, nlen + 1);
+    if (access(buf, X_OK) == 0 && stat(buf, &st) == 0 && S_ISREG(st.st_mode)) {
+      *out_path = buf;
+      return 0;
+    }
+    if (errno == EACCES) {
+      err = EACCES;
+    }
+    if (*e == '\0') {
+      break;
+    }
+  }
+  return iwrc_set_errno(IW_ERROR_ERRNO, err);
+}
+
+#ifdef __linux__
+
+struct spawn_ctx {
+  struct proc *proc;
+  const char  *path; ///< Path of executable
+  const int   *fds;
+  sigset_t     sigmask;
+  pid_t ppid;
+  int   err;
+};
+
+/// Child side of spawn. Runs on the parent memory until `exec()`,
+/// so only syscalls are allowed here.
+static int _proc_spawn_child(void *op) {
+  extern char **environ;
+  struct spawn_ctx *ctx = op;
+  struct proc *proc = ctx->proc;
+  const int *fds = ctx->fds;
+
+  // Signal handlers of parent must not be called on shared memory
+  for (int i = 1; i < NSIG; ++i) {
+    struct sigaction sa;
+    if (sigaction(i, 0, &sa) == 0 && sa.sa_handler != SIG_DFL && sa.sa_handler != SIG_IGN) {
+      sa.sa_handler = SIG_DFL;
+      sa.sa_flags = 0;
+      sigemptyset(&sa.sa_mask);
+      sigaction(i, &sa, 0);
+    }
+  }
+  if (proc->spec.parent_death_signal) {
+    if (prctl(PR_SET_PDEATHSIG, proc->spec.parent_death_signal) == -1) {
+      goto fail;
+    }
+    if (getppid() != ctx->ppid) {
+      errno = ESRCH;
+      goto fail;
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    // {stdout, stderr, stdin} pipes, child side is the write end for stdout/stderr
+    int cfd = i < 2 ? fds[i * 2 + 1] : fds[4];
+    if (cfd > -1) {
+      int tfd = i == 0 ? STDOUT_FILENO : i == 1 ? STDERR_FILENO : STDIN_FILENO;
+      while ((dup2(cfd, tfd) == -1) && (errno == EINTR));
+      close(fds[i * 2]);
+      close(fds[i * 2 + 1]);
+    }
+  }
+  pthread_sigmask(SIG_SETMASK, &ctx->sigmask, 0);
+
+  execve(ctx->path, proc->argv, proc->envp ? proc->envp : environ);
+
+fail:
+  ctx->err = errno;
+  _exit(127);
+}
+
+/// Spawns child by `clone(CLONE_VM | CLONE_VFORK)`. Unlike `fork()` it doesn't copy
+/// page tables of the parent, so spawn time doesn't depend on the parent memory size.
+/// Parent is suspended until the child calls `exec()` so exec errors are reported back.
+static iwrc _proc_spawn_fast(struct proc *proc, const int fds[6], pid_t *out_pid) {
+  iwrc rc = 0;
+  sigset_t all;
+  struct spawn_ctx ctx = {
+    .proc = proc,
+    .fds  = fds,
+    .ppid = getpid(),
+  };
+
+  RCR(_proc_exec_path(proc, &ctx.path));
+
+  void *stack = mmap(0, SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &ctx.sigmask);
+  pid_t pid = clone(_proc_spawn_child, (char*) stack + SPAWN_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD, &ctx);
+  if (pid == -1) {
+    rc = iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  pthread_sigmask(SIG_SETMASK, &ctx.sigmask, 0);
+  munmap(stack, SPAWN_STACK_SIZE);
+
+  if (!rc && ctx.err) {
+    rc = iwrc_set_errno(IW_ERROR_ERRNO, ctx.err);
+    if (waitpid(pid, 0, 0) == -1) {
+      _proc_reaped_apply(pid); // Reaped by wait worker
+    }
+  }
+  if (!rc) {
+    *out_pid = pid;
+  }
+  return rc;
+}
+
+#else
+
+/// Spawns child by `posix_spawn()` which avoids copying of the parent address space
+/// on the most of platforms.
+static iwrc _proc_spawn_fast(struct proc *proc, const int fds[6], pid_t *out_pid) {
+  extern char **environ;
+  int rci;
+  pid_t pid = -1;
+  const char *path;
+  posix_spawn_file_actions_t fa;
+
+  RCR(_proc_exec_path(proc, &path));
+
+  rci = posix_spawn_file_actions_init(&fa);
+  if (rci) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, rci);
+  }
+  for (int i = 0; i < 3; ++i) {
+    int cfd = i < 2 ? fds[i * 2 + 1] : fds[4];
+    if (cfd > -1) {
+      int tfd = i == 0 ? STDOUT_FILENO : i == 1 ? STDERR_FILENO : STDIN_FILENO;
+      posix_spawn_file_actions_adddup2(&fa, cfd, tfd);
+      posix_spawn_file_actions_addclose(&fa, fds[i * 2]);
+      posix_spawn_file_actions_addclose(&fa, fds[i * 2 + 1]);
+    }
+  }
+  rci = posix_spawn(&pid, path, &fa, 0, proc->argv, proc->envp ? proc->envp : environ);
+  posix_spawn_file_actions_destroy(&fa);
+  if (rci) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, rci);
+  }
+  *out_pid = pid;
+  return 0;
+}
+
+#endif
+
 iwrc iwn_proc_spawn(const struct iwn_proc_spec *spec, pid_t *out_pid) {
   iwrc rc = 0;
   if (!spec || !spec->path || !spec->poller || !out_pid) {
@@ -556,7 +992,7 @@ iwrc iwn_proc_spawn(const struct iwn_proc_spec *spec, pid_t *out_pid) {
 
   *out_pid = -1;
 
-  bool bv, proc_added = false;
+  bool proc_added = false, spawning = false;
   struct proc *proc = 0;
   int fds[6] = { -1, -1, -1, -1, -1, -1 };
 
@@ -566,16 +1002,40 @@ iwrc iwn_proc_spawn(const struct iwn_proc_spec *spec, pid_t *out_pid) {
 #ifdef __linux__
   pid_t ppid = getpid();
 #endif
-  pid_t pid = fork();
+  pid_t pid = -1;
+
+  _proc_spawn_begin();
+  spawning = true;
+
+  if (!spec->on_fork) {
+    rc = _proc_spawn_fast(proc, fds, &pid);
+    if (rc) {
+      int cfds[] = { fds[1], fds[3], fds[4] }; // Child side of pipes
+      for (int i = 0; i < sizeof(cfds) / sizeof(cfds[0]); ++i) {
+        if (cfds[i] > -1) {
+          close(cfds[i]);
+        }
+      }
+      goto finish;
+    }
+  } else {
+    pid = fork();
+  }
 
   if (pid > 0) { // Parent
     *out_pid = pid;
     proc->pid = pid;
 
     rc = _proc_add(proc);
+#ifdef HAVE_PIDFD
+    if (!rc && !_proc_pidfd_watch(spec->poller, pid)) {
+      rc = _proc_wait_worker_start();
+    }
+#else
     if (!rc) {
-      rc = iwstw_schedule_empty_only(cc.stw, _proc_wait_worker, 0, &bv);
+      rc = _proc_wait_worker_start();
     }
+#endif
     if (rc) {
       iwlog_ecode_error(rc, "proc | Killing %d due to the error", pid);
       kill(pid, SIGKILL);
@@ -643,6 +1103,9 @@ iwrc iwn_proc_spawn(const struct iwn_proc_spec *spec, pid_t *out_pid) {
     if (spec->on_fork) {
       spec->on_fork((void*) proc, pid);
     }
+    _proc_reaped_apply(pid);
+    _proc_spawn_end();
+    spawning = false;
   } else if (pid == 0) { // Child
 #ifdef __linux__
     if (spec->parent_death_signal) {
@@ -682,7 +1145,7 @@ iwrc iwn_proc_spawn(const struct iwn_proc_spec *spec, pid_t *out_pid) {
     }
 
     if (spec->find_executable_in_path) {
-      RCN(finish, execvp(proc->path, proc->argv));
+      RCN(child_exit, execvp(proc->path, proc->argv));
     } else {
       RCN(child_exit, execv(proc->path, proc->argv));
     }
@@ -693,6 +1156,9 @@ iwrc iwn_proc_spawn(const struct iwn_proc_spec *spec, pid_t *out_pid) {
   }
 
 finish:
+  if (spawning) {
+    _proc_spawn_end();
+  }
   if (rc) {
     if (!proc_added) {
       _proc_destroy(proc);
@@ -724,13 +1190,18 @@ char* iwn_proc_command_get(const struct iwn_proc_spec *spec) {
 }
 
 void iwn_proc_dispose(void) {
-  IWHMAP *map = 0;
+  IWHMAP *map = 0, *reaped = 0;
   iwn_proc_kill_all(SIGTERM);
   pthread_mutex_lock(&cc.mtx);
   map = cc.map;
+  reaped = cc.reaped;
   cc.map = 0;
+  cc.reaped = 0;
   pthread_cond_broadcast(&cc.cond);
   pthread_mutex_unlock(&cc.mtx);
-  iwstw_shutdown(&cc.stw, false);
+  if (cc.stw) {
+    iwstw_shutdown(&cc.stw, false);
+  }
   iwhmap_destroy(map);
+  iwhmap_destroy(reaped);
 }
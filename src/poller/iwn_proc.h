@@ -45,7 +45,27 @@ struct iwn_proc_spec {
   /// On child process exit.
   void (*on_exit)(const struct iwn_proc_ctx *ctx_exit);
 
+  /// Size of reusable read buffer allocated for every output stream of the child process.
+  /// Data passed into `on_stdout` and `on_stderr` callbacks points into this buffer.
+  /// Default: 64K
+  size_t read_buf_size;
+
+  /// If true `on_stdout` and `on_stderr` are called for every line of output without trailing `\n`.
+  /// Lines longer than `read_buf_size` are split into chunks.
+  bool output_lines;
+
+  /// If greater than zero child stdout is forwarded to this file descriptor
+  /// using `splice()` on Linux, `on_stdout` is ignored in this case.
+  /// File descriptor should be in blocking mode and it is not closed by iwn_proc.
+  int forward_stdout_fd;
+
+  /// If greater than zero child stderr is forwarded to this file descriptor,
+  /// see `forward_stdout_fd`.
+  int forward_stderr_fd;
+
   /// On fork handler. We are on the child side if pid is zero.
+  /// NOTE: If set child is spawned by `fork()` which is slow for parents with big memory footprint,
+  /// otherwise child is spawned without copying of the parent address space.
   void (*on_fork)(const struct iwn_proc_ctx *ctx, pid_t pid);
 
   /// Sends a given signal to the child process if parent process exits.
@@ -59,7 +79,8 @@ struct iwn_proc_spec {
   bool find_executable_in_path;
 };
 
-/// Spawn (fork) new process according to the given specification.
+/// Spawn new process according to the given specification.
+/// Errors of executable launch are reported by returned code unless `on_fork` handler is set.
 /// @param spec Process specification.
 /// @param[out] Process `pid` holder.
 ///
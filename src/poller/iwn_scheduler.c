@@ -6,13 +6,30 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-#if defined(IWN_KQUEUE)
-#include <sys/event.h>
-#elif defined(IWN_EPOLL)
-#include <sys/epoll.h>
-#include <sys/timerfd.h>
-#endif
+struct periodic {
+  struct iwn_scheduler_spec spec;
+  int64_t start; ///< Time of the first run in milliseconds
+};
+
+static int64_t _time_ms(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+/// Returns poller slot flags of task priority lane.
+static uint32_t _events_mod(const struct iwn_scheduler_spec *spec) {
+  switch (spec->prio) {
+    case IWN_POLLER_PRIO_HIGH:
+      return IWN_POLLPRIO;
+    case IWN_POLLER_PRIO_BACKGROUND:
+      return IWN_POLLBACKGROUND;
+    default:
+      return 0;
+  }
+}
 
 static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
   struct iwn_scheduler_spec *s = t->user_data;
@@ -49,6 +66,7 @@ iwrc iwn_schedule2(const struct iwn_scheduler_spec *spec, int *out_fd) {
     .on_dispose = _on_dispose,
     .user_data = task,
     .events = IWN_POLLTIMEOUT,
+    .events_mod = _events_mod(spec),
     .timeout = spec->timeout_ms
   }, out_fd));
 
@@ -59,6 +77,64 @@ finish:
   return rc;
 }
 
+/// Returns time of the next periodic task run after `now`.
+static int64_t _periodic_next(const struct periodic *t, int64_t now) {
+  int64_t period = t->spec.period_ms;
+  int64_t next = now < t->start ? t->start : t->start + ((now - t->start) / period + 1) * period;
+  if (t->spec.slack_ms > 1) {
+    int64_t slack = t->spec.slack_ms;
+    next = (next + slack - 1) / slack * slack;
+  }
+  return next;
+}
+
+static int64_t _on_periodic_ready(const struct iwn_poller_task *t, uint32_t events) {
+  struct periodic *pt = t->user_data;
+  pt->spec.task_fn(pt->spec.user_data);
+  int64_t now = _time_ms();
+  return MAX(1, _periodic_next(pt, now) - now);
+}
+
+static void _on_periodic_dispose(const struct iwn_poller_task *t) {
+  struct periodic *pt = t->user_data;
+  if (pt->spec.on_cancel) {
+    pt->spec.on_cancel(pt->spec.user_data);
+  }
+  if (pt->spec.on_dispose) {
+    pt->spec.on_dispose(pt->spec.user_data);
+  }
+  free(pt);
+}
+
+iwrc iwn_schedule_periodic(const struct iwn_scheduler_spec *spec, int *out_fd) {
+  if (!spec || spec->period_ms < 1 || !spec->task_fn || !spec->poller) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  iwrc rc = 0;
+  struct periodic *task = malloc(sizeof(*task));
+  RCB(finish, task);
+  memcpy(&task->spec, spec, sizeof(task->spec));
+
+  int64_t now = _time_ms();
+  task->start = now + (spec->timeout_ms ? spec->timeout_ms : spec->period_ms);
+
+  RCC(rc, finish, iwn_poller_add2(&(struct iwn_poller_task) {
+    .poller = spec->poller,
+    .on_ready = _on_periodic_ready,
+    .on_dispose = _on_periodic_dispose,
+    .user_data = task,
+    .events = IWN_POLLTIMEOUT,
+    .events_mod = _events_mod(spec),
+    .timeout = MAX(1, _periodic_next(task, now) - now)
+  }, out_fd));
+
+finish:
+  if (rc) {
+    free(task);
+  }
+  return rc;
+}
+
 iwrc iwn_schedule(const struct iwn_scheduler_spec *spec) {
   return iwn_schedule2(spec, 0);
 }
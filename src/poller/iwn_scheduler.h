@@ -21,11 +21,27 @@ struct iwn_scheduler_spec {
   void *user_data;              ///< User data passed to `task_fn()` function.
   struct iwn_poller *poller;    ///< Poller.
   uint32_t timeout_ms;          ///< Task timeout in milliseconds.
+  int prio;                     ///< Priority lane of task execution. Default: IWN_POLLER_PRIO_NORMAL
+  uint32_t period_ms;           ///< Period of periodic task in milliseconds, see iwn_schedule_periodic().
+  uint32_t slack_ms;            ///< Optional periodic task timer slack in milliseconds.
+                                ///  Task runs are delayed to the nearest multiple of `slack_ms` on monotonic clock,
+                                ///  so periodic tasks having the same slack are executed by the same timer wakeup.
 };
 
 /// Submits delayed task for execution.
 IW_EXPORT iwrc iwn_schedule(const struct iwn_scheduler_spec *spec);
 
+/// Submits delayed task for execution.
+/// Task handle is returned in `out_fd`, pending task can be cancelled by `iwn_poller_remove()`.
+/// Note: handle is a negative number less than -1, it is not a file descriptor.
 IW_EXPORT iwrc iwn_schedule2(const struct iwn_scheduler_spec *spec, int *out_fd);
 
+/// Submits periodic task executed every `spec->period_ms` milliseconds.
+/// The first run is after `spec->timeout_ms` milliseconds or after `period_ms` if `timeout_ms` is zero.
+/// Runs are scheduled at fixed rate without drift: if a run is late, missed runs are skipped
+/// and the next one is aligned to the original schedule.
+/// Task handle is returned in optional `out_fd`, task is cancelled by `iwn_poller_remove()`
+/// with `on_cancel()` called, the same handle is valid for all task runs.
+IW_EXPORT iwrc iwn_schedule_periodic(const struct iwn_scheduler_spec *spec, int *out_fd);
+
 IW_EXTERN_C_END
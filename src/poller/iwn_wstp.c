@@ -0,0 +1,349 @@
+#include "iwn_wstp.h"
+
+#include <iowow/iwlog.h>
+#include <iowow/iwp.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define THREADS_MAX   1024
+#define QUEUE_INITIAL 64
+#define STEAL_MAX     32 ///< Max number of tasks stolen at once
+
+struct task {
+  iwn_wstp_task_f fn;
+  void *arg;
+};
+
+struct worker {
+  struct iwn_wstp *tp;
+  struct task     *tasks; ///< Ring buffer of tasks, guarded by `mtx`
+  uint32_t   cap;         ///< Capacity of `tasks` ring, power of two
+  uint32_t   head;        ///< Index of the oldest task in the ring
+  atomic_int size;        ///< Number of tasks in the ring, updated under `mtx`
+  int  idx;
+  bool sleeping;          ///< Worker is waiting for tasks, guarded by `mtx`
+  pthread_t       thr;
+  pthread_mutex_t mtx;
+  pthread_cond_t  cond;
+};
+
+struct iwn_wstp {
+  struct worker *workers;
+  int  num_workers;
+  int  num_started;
+  int  queue_limit;
+  char thread_name_prefix[32];
+  atomic_int  queue_size;   ///< Number of pending tasks in all queues
+  atomic_int  num_sleeping; ///< Number of workers waiting for tasks
+  atomic_bool shutdown;
+  atomic_bool discard;      ///< Pending tasks should be discarded on shutdown
+};
+
+/// Worker of the current thread.
+static __thread struct worker *_tl_worker;
+
+/// Pushes a task to the tail of worker queue. Caller must hold worker lock.
+static bool _queue_push_lk(struct worker *w, iwn_wstp_task_f fn, void *arg) {
+  uint32_t size = (uint32_t) atomic_load_explicit(&w->size, memory_order_relaxed);
+  if (size == w->cap) {
+    uint32_t ncap = w->cap ? w->cap * 2 : QUEUE_INITIAL;
+    struct task *ntasks = malloc(ncap * sizeof(*ntasks));
+    if (!ntasks) {
+      return false;
+    }
+    for (uint32_t i = 0; i < size; ++i) {
+      ntasks[i] = w->tasks[(w->head + i) & (w->cap - 1)];
+    }
+    free(w->tasks);
+    w->tasks = ntasks;
+    w->cap = ncap;
+    w->head = 0;
+  }
+  w->tasks[(w->head + size) & (w->cap - 1)] = (struct task) {
+    .fn = fn,
+    .arg = arg
+  };
+  atomic_store(&w->size, size + 1);
+  return true;
+}
+
+/// Takes the oldest task from worker's own queue.
+static bool _queue_pop(struct worker *w, struct task *out) {
+  if (atomic_load(&w->size) == 0) {
+    return false;
+  }
+  bool ret = false;
+  pthread_mutex_lock(&w->mtx);
+  int size = atomic_load_explicit(&w->size, memory_order_relaxed);
+  if (size > 0) {
+    *out = w->tasks[w->head];
+    w->head = (w->head + 1) & (w->cap - 1);
+    atomic_store(&w->size, size - 1);
+    ret = true;
+  }
+  pthread_mutex_unlock(&w->mtx);
+  return ret;
+}
+
+/// Steals up to a half of the newest tasks of `victim` queue into `out` array.
+static int _queue_steal(struct worker *victim, struct task out[static STEAL_MAX]) {
+  if (atomic_load(&victim->size) == 0) {
+    return 0;
+  }
+  pthread_mutex_lock(&victim->mtx);
+  int size = atomic_load_explicit(&victim->size, memory_order_relaxed);
+  int n = (size + 1) / 2;
+  if (n > STEAL_MAX) {
+    n = STEAL_MAX;
+  }
+  for (int i = 0; i < n; ++i) {
+    out[i] = victim->tasks[(victim->head + size - n + i) & (victim->cap - 1)];
+  }
+  atomic_store(&victim->size, size - n);
+  pthread_mutex_unlock(&victim->mtx);
+  return n;
+}
+
+/// Takes a task from worker own queue or steals it from other workers.
+static bool _task_take(struct worker *w, struct task *out) {
+  if (_queue_pop(w, out)) {
+    return true;
+  }
+  struct iwn_wstp *tp = w->tp;
+  struct task stolen[STEAL_MAX];
+  for (int i = 1; i < tp->num_workers; ++i) {
+    int n = _queue_steal(&tp->workers[(w->idx + i) % tp->num_workers], stolen);
+    if (n == 0) {
+      continue;
+    }
+    if (n > 1) {
+      pthread_mutex_lock(&w->mtx);
+      for (int j = 1; j < n; ++j) {
+        if (!_queue_push_lk(w, stolen[j].fn, stolen[j].arg)) {
+          // Not enough memory to keep stolen task, run it right away
+          pthread_mutex_unlock(&w->mtx);
+          atomic_fetch_sub(&tp->queue_size, 1);
+          stolen[j].fn(stolen[j].arg);
+          pthread_mutex_lock(&w->mtx);
+        }
+      }
+      pthread_mutex_unlock(&w->mtx);
+    }
+    *out = stolen[0];
+    return true;
+  }
+  return false;
+}
+
+/// Wakes up a sleeping worker, `w` is the worker to start search from.
+static void _wake_one(struct iwn_wstp *tp, struct worker *w) {
+  for (int i = 1; i < tp->num_workers && atomic_load(&tp->num_sleeping) > 0; ++i) {
+    struct worker *v = &tp->workers[(w->idx + i) % tp->num_workers];
+    pthread_mutex_lock(&v->mtx);
+    if (v->sleeping) {
+      v->sleeping = false;
+      pthread_cond_signal(&v->cond);
+      pthread_mutex_unlock(&v->mtx);
+      return;
+    }
+    pthread_mutex_unlock(&v->mtx);
+  }
+}
+
+static void* _worker_fn(void *d) {
+  struct worker *w = d;
+  struct iwn_wstp *tp = w->tp;
+  struct task t;
+  char name[64];
+
+  _tl_worker = w;
+  snprintf(name, sizeof(name), "%s%d", tp->thread_name_prefix, w->idx);
+  iwp_set_current_thread_name(name);
+
+  while (!tp->discard) {
+    if (_task_take(w, &t)) {
+      atomic_fetch_sub(&tp->queue_size, 1);
+      t.fn(t.arg);
+      continue;
+    }
+    if (tp->shutdown) {
+      break;
+    }
+    // Announce sleeping and recheck queues, so task scheduled in the meantime
+    // either is found here or its scheduler sees this worker sleeping.
+    pthread_mutex_lock(&w->mtx);
+    w->sleeping = true;
+    pthread_mutex_unlock(&w->mtx);
+    atomic_fetch_add(&tp->num_sleeping, 1);
+
+    bool found = _task_take(w, &t);
+
+    pthread_mutex_lock(&w->mtx);
+    if (found || tp->shutdown) {
+      w->sleeping = false;
+    }
+    while (w->sleeping) {
+      pthread_cond_wait(&w->cond, &w->mtx);
+    }
+    pthread_mutex_unlock(&w->mtx);
+    atomic_fetch_sub(&tp->num_sleeping, 1);
+
+    if (found) {
+      atomic_fetch_sub(&tp->queue_size, 1);
+      t.fn(t.arg);
+    }
+  }
+
+  _tl_worker = 0;
+  return 0;
+}
+
+iwrc iwn_wstp_schedule(IWN_WSTP tp, iwn_wstp_task_f fn, void *arg) {
+  if (!tp || !fn) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  struct worker *w = _tl_worker;
+  if (w && w->tp != tp) {
+    w = 0;
+  }
+  if (tp->shutdown && !w) {
+    // Only tasks scheduled by pool workers are accepted while pool is shutting down
+    return IW_ERROR_INVALID_STATE;
+  }
+  int qs = atomic_fetch_add(&tp->queue_size, 1);
+  if (tp->queue_limit > 0 && qs >= tp->queue_limit) {
+    atomic_fetch_sub(&tp->queue_size, 1);
+    return IW_ERROR_OVERFLOW;
+  }
+  if (!w) {
+    // Tasks of the same object go to the same worker
+    uint64_t h = (uint64_t) (uintptr_t) arg * 0x9e3779b97f4a7c15ULL;
+    w = &tp->workers[(h >> 32) % (uint64_t) tp->num_workers];
+  }
+
+  pthread_mutex_lock(&w->mtx);
+  if (!_queue_push_lk(w, fn, arg)) {
+    pthread_mutex_unlock(&w->mtx);
+    atomic_fetch_sub(&tp->queue_size, 1);
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  bool woken = w->sleeping;
+  if (woken) {
+    w->sleeping = false;
+    pthread_cond_signal(&w->cond);
+  }
+  pthread_mutex_unlock(&w->mtx);
+
+  // Target worker is busy, let an idle worker steal the task
+  if (!woken && atomic_load(&tp->num_sleeping) > 0) {
+    _wake_one(tp, w);
+  }
+  return 0;
+}
+
+int iwn_wstp_queue_size(IWN_WSTP tp) {
+  return tp ? atomic_load(&tp->queue_size) : 0;
+}
+
+static void _destroy(struct iwn_wstp *tp) {
+  for (int i = 0; i < tp->num_workers; ++i) {
+    struct worker *w = &tp->workers[i];
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mtx);
+    free(w->tasks);
+  }
+  free(tp->workers);
+  free(tp);
+}
+
+iwrc iwn_wstp_shutdown(IWN_WSTP *tpp, bool wait_for_all) {
+  if (!tpp || !*tpp) {
+    return 0;
+  }
+  struct iwn_wstp *tp = *tpp;
+  *tpp = 0;
+
+  for (int i = 0; i < tp->num_started; ++i) {
+    if (pthread_equal(tp->workers[i].thr, pthread_self())) {
+      iwlog_error2("Thread pool cannot be shutdown by its own worker");
+      return IW_ERROR_INVALID_STATE;
+    }
+  }
+
+  if (!wait_for_all) {
+    tp->discard = true;
+  }
+  tp->shutdown = true;
+  for (int i = 0; i < tp->num_workers; ++i) {
+    struct worker *w = &tp->workers[i];
+    pthread_mutex_lock(&w->mtx);
+    w->sleeping = false;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mtx);
+  }
+  for (int i = 0; i < tp->num_started; ++i) {
+    pthread_join(tp->workers[i].thr, 0);
+  }
+  _destroy(tp);
+  return 0;
+}
+
+iwrc iwn_wstp_start_by_spec(const struct iwn_wstp_spec *spec, IWN_WSTP *out_tp) {
+  if (!spec || !out_tp) {
+    return IW_ERROR_INVALID_ARGS;
+  }
+  *out_tp = 0;
+
+  iwrc rc = 0;
+  int num_threads = spec->num_threads;
+  if (num_threads < 1) {
+    num_threads = iwp_num_cpu_cores();
+    if (num_threads < 1) {
+      num_threads = 1;
+    }
+  }
+  if (num_threads > THREADS_MAX) {
+    num_threads = THREADS_MAX;
+  }
+
+  struct iwn_wstp *tp = calloc(1, sizeof(*tp));
+  if (!tp) {
+    return iwrc_set_errno(IW_ERROR_ALLOC, errno);
+  }
+  tp->workers = calloc(num_threads, sizeof(*tp->workers));
+  if (!tp->workers) {
+    rc = iwrc_set_errno(IW_ERROR_ALLOC, errno);
+    free(tp);
+    return rc;
+  }
+  tp->queue_limit = spec->queue_limit > 0 ? spec->queue_limit : 0;
+  snprintf(tp->thread_name_prefix, sizeof(tp->thread_name_prefix), "%s",
+           spec->thread_name_prefix ? spec->thread_name_prefix : "wstp-");
+
+  for ( ; tp->num_workers < num_threads; ++tp->num_workers) {
+    struct worker *w = &tp->workers[tp->num_workers];
+    w->tp = tp;
+    w->idx = tp->num_workers;
+    pthread_mutex_init(&w->mtx, 0);
+    pthread_cond_init(&w->cond, 0);
+  }
+  for ( ; tp->num_started < num_threads; ++tp->num_started) {
+    struct worker *w = &tp->workers[tp->num_started];
+    int rci = pthread_create(&w->thr, 0, _worker_fn, w);
+    if (rci) {
+      rc = iwrc_set_errno(IW_ERROR_THREADING_ERRNO, rci);
+      iwn_wstp_shutdown(&tp, false);
+      return rc;
+    }
+  }
+
+  *out_tp = tp;
+  return rc;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/// Work stealing thread pool.
+///
+/// Every worker thread has its own tasks queue, tasks scheduled by worker itself
+/// are put into its own queue, other tasks are distributed between workers by `arg` hash
+/// so consecutive tasks of the same object tend to be executed by the same worker.
+/// Idle workers steal tasks from queues of busy ones.
+
+#include <iowow/basedefs.h>
+
+IW_EXTERN_C_START
+
+struct iwn_wstp;
+typedef struct iwn_wstp *IWN_WSTP;
+
+/// Task function.
+typedef void (*iwn_wstp_task_f)(void *arg);
+
+struct iwn_wstp_spec {
+  /// Thread name prefix, worker index is appended to it.
+  /// Default: `wstp-`
+  const char *thread_name_prefix;
+
+  /// Number of worker threads.
+  /// Number of cpu cores if zero.
+  /// Max: 1024
+  int num_threads;
+
+  /// Max number of pending tasks in all queues.
+  /// Default: 0 (unlimited)
+  int queue_limit;
+};
+
+/// Starts a work stealing thread pool.
+/// Returned pool should be disposed by `iwn_wstp_shutdown()`.
+IW_EXPORT iwrc iwn_wstp_start_by_spec(const struct iwn_wstp_spec *spec, IWN_WSTP *out_tp);
+
+/// Schedules a task for execution.
+/// @return IW_ERROR_OVERFLOW if `queue_limit` is reached.
+IW_EXPORT iwrc iwn_wstp_schedule(IWN_WSTP tp, iwn_wstp_task_f fn, void *arg);
+
+/// Returns number of pending tasks.
+IW_EXPORT int iwn_wstp_queue_size(IWN_WSTP tp);
+
+/// Shutdowns thread pool and disposes it.
+/// @param wait_for_all If true all pending tasks will be executed before shutdown.
+IW_EXPORT iwrc iwn_wstp_shutdown(IWN_WSTP *tpp, bool wait_for_all);
+
+IW_EXTERN_C_END
@@ -0,0 +1,90 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#if defined(__linux__)
+#include <sched.h>
+
+static struct iwn_poller *poller;
+static atomic_int num_checked;
+
+static bool _thread_pinned_to(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set)) {
+    return false;
+  }
+  return CPU_COUNT(&set) == 1 && CPU_ISSET(cpu, &set);
+}
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[16];
+  while (read(t->fd, buf, sizeof(buf)) > 0);
+  IWN_ASSERT(_thread_pinned_to(0));
+  ++num_checked;
+  return -1;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  close((int) (intptr_t) t->user_data);
+  close(t->fd);
+}
+
+static void _test_affinity(unsigned flags) {
+  int cpus[] = { 0 };
+  int fds[2];
+
+  num_checked = 0;
+  iwrc rc = iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .num_shards = 2,
+    .flags = flags,
+    .cpus = cpus,
+    .num_cpus = sizeof(cpus) / sizeof(cpus[0]),
+  }, &poller);
+  IWN_ASSERT_FATAL(rc == 0);
+
+  for (int i = 0; i < 4; ++i) {
+    IWN_ASSERT_FATAL(pipe2(fds, O_NONBLOCK) == 0);
+    rc = iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = fds[0],
+      .user_data = (void*) (intptr_t) fds[1],
+      .on_ready = _on_ready,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLONESHOT,
+      .poller = poller
+    });
+    IWN_ASSERT(rc == 0);
+    IWN_ASSERT(write(fds[1], "x", 1) == 1);
+  }
+
+  iwn_poller_poll(poller);
+  IWN_ASSERT(num_checked == 4);
+  // Poll thread is pinned too
+  IWN_ASSERT(_thread_pinned_to(0));
+  iwn_poller_destroy(&poller);
+}
+
+int main(int argc, char *argv[]) {
+  iwlog_init();
+  _test_affinity(0);
+  _test_affinity(IWN_POLLER_NUMA);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#define NUM_WRITES 200
+
+static struct iwn_poller *poller;
+static int fds[2];
+static atomic_int num_read;
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[16];
+  ssize_t len;
+  while ((len = read(t->fd, buf, sizeof(buf))) > 0) {
+    num_read += len;
+  }
+  return 0;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  close(fds[1]);
+  close(t->fd);
+}
+
+static void* _producer(void *d) {
+  for (int i = 0; i < NUM_WRITES; ++i) {
+    IWN_ASSERT(write(fds[1], "x", 1) == 1);
+    usleep(i < NUM_WRITES / 2 ? 10 : 5000); // Frequent events then idle periods
+  }
+  for (int i = 0; i < 1000 && num_read < NUM_WRITES; ++i) {
+    usleep(1000);
+  }
+  iwn_poller_remove(poller, fds[0]);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t producer;
+  struct iwn_poller_stats stats;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 1,
+    .flags = IWN_POLLER_STATS | IWN_POLLER_INLINE,
+    .busy_poll_us = 1000,
+  }, &poller));
+
+  IWN_ASSERT_FATAL(pipe(fds) == 0);
+  IWN_ASSERT_FATAL(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+  RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+    .fd = fds[0],
+    .on_ready = _on_ready,
+    .on_dispose = _on_dispose,
+    .events = IWN_POLLIN,
+    .events_mod = IWN_POLLET | IWN_POLLINLINE,
+    .poller = poller
+  }));
+
+  pthread_create(&producer, 0, _producer, 0);
+  iwn_poller_poll(poller);
+  pthread_join(producer, 0);
+
+  IWN_ASSERT(num_read == NUM_WRITES);
+  iwn_poller_stats(poller, &stats);
+  IWN_ASSERT(stats.busy_polls > 0);
+  IWN_ASSERT(stats.busy_polls <= stats.polls);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
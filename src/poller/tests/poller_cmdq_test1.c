@@ -0,0 +1,97 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#define NUM_PIPES  200
+#define NUM_ROUNDS 10
+
+static struct iwn_poller *poller;
+static int wfds[NUM_PIPES];
+static int rfds[NUM_PIPES];
+static atomic_int num_read;
+static atomic_int num_disposed;
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[16];
+  ssize_t len;
+  while ((len = read(t->fd, buf, sizeof(buf))) > 0) {
+    num_read += len;
+  }
+  return 0; // Rearmed by producer
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  close((int) (intptr_t) t->user_data);
+  close(t->fd);
+  ++num_disposed;
+}
+
+static void* _producer(void *d) {
+  for (int r = 0; r < NUM_ROUNDS; ++r) {
+    for (int i = 0; i < NUM_PIPES; ++i) {
+      IWN_ASSERT(write(wfds[i], "x", 1) == 1);
+    }
+    for (int i = 0; i < NUM_PIPES; ++i) {
+      IWN_ASSERT(iwn_poller_arm_events(poller, rfds[i], IWN_POLLIN) == 0);
+    }
+    for (int i = 0; i < 1000 && num_read < NUM_PIPES * (r + 1); ++i) {
+      usleep(1000);
+    }
+    IWN_ASSERT(num_read == NUM_PIPES * (r + 1));
+  }
+  for (int i = 0; i < NUM_PIPES; ++i) {
+    iwn_poller_remove(poller, rfds[i]);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t producer;
+  struct iwn_poller_stats stats;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .num_shards = 2,
+    .flags = IWN_POLLER_CMD_QUEUE | IWN_POLLER_STATS,
+  }, &poller));
+
+  for (int i = 0; i < NUM_PIPES; ++i) {
+    int fds[2];
+    IWN_ASSERT_FATAL(pipe(fds) == 0);
+    IWN_ASSERT_FATAL(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+    rfds[i] = fds[0];
+    wfds[i] = fds[1];
+    RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = fds[0],
+      .user_data = (void*) (intptr_t) fds[1],
+      .on_ready = _on_ready,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLONESHOT,
+      .poller = poller
+    }));
+  }
+
+  pthread_create(&producer, 0, _producer, 0);
+  iwn_poller_poll(poller);
+  pthread_join(producer, 0);
+
+  IWN_ASSERT(num_read == NUM_PIPES * NUM_ROUNDS);
+
+  iwn_poller_stats(poller, &stats);
+  IWN_ASSERT(stats.commands > 0);
+  IWN_ASSERT(stats.commands <= NUM_PIPES * (NUM_ROUNDS + 1));
+  IWN_ASSERT(stats.fds == 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  IWN_ASSERT(num_disposed == NUM_PIPES);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
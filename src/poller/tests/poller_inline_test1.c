@@ -0,0 +1,127 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#define NUM_WRITES 100
+
+struct chan {
+  int       pair[2];
+  atomic_int num_read;
+  atomic_int num_reactor; ///< Number of handler calls made by the reactor thread
+};
+
+static pthread_t reactor;
+static struct iwn_poller *poller;
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  struct chan *c = t->user_data;
+  char buf[64];
+  ssize_t len;
+  if (pthread_equal(pthread_self(), reactor)) {
+    ++c->num_reactor;
+  }
+  while ((len = read(t->fd, buf, sizeof(buf))) > 0) {
+    c->num_read += (int) len;
+  }
+  return 0;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  struct chan *c = t->user_data;
+  close(c->pair[1]);
+}
+
+static iwrc _chan_add(struct chan *c, uint32_t events_mod) {
+  iwrc rc = 0;
+  int rci = socketpair(AF_UNIX, SOCK_STREAM, 0, c->pair);
+  IWN_ASSERT_FATAL(rci == 0);
+  rci = fcntl(c->pair[0], F_SETFL, O_NONBLOCK);
+  IWN_ASSERT_FATAL(rci == 0);
+  RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+    .fd = c->pair[0],
+    .user_data = c,
+    .on_ready = _on_ready,
+    .on_dispose = _on_dispose,
+    .events = IWN_POLLIN,
+    .events_mod = IWN_POLLET | events_mod,
+    .poller = poller
+  }));
+finish:
+  return rc;
+}
+
+static void* _writer(void *d) {
+  struct chan **chans = d;
+  for (int i = 0; i < NUM_WRITES; ++i) {
+    for (int j = 0; chans[j]; ++j) {
+      IWN_ASSERT(write(chans[j]->pair[1], "x", 1) == 1);
+    }
+    usleep(1000);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    bool done = true;
+    for (int j = 0; chans[j]; ++j) {
+      if (chans[j]->num_read < NUM_WRITES) {
+        done = false;
+      }
+    }
+    if (done) {
+      break;
+    }
+    usleep(1000);
+  }
+  iwn_poller_shutdown_request(poller);
+  return 0;
+}
+
+static iwrc _run(uint32_t poller_flags, struct chan **chans, const uint32_t *events_mod) {
+  iwrc rc = 0;
+  pthread_t writer;
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .flags = poller_flags,
+  }, &poller));
+  for (int i = 0; chans[i]; ++i) {
+    RCC(rc, finish, _chan_add(chans[i], events_mod[i]));
+  }
+  reactor = pthread_self();
+  pthread_create(&writer, 0, _writer, chans);
+  iwn_poller_poll(poller);
+  pthread_join(writer, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  iwlog_init();
+
+  // Inline poller: all handlers except blocking ones are executed by the reactor
+  struct chan c1 = { 0 }, c2 = { 0 };
+  RCC(rc, finish, _run(IWN_POLLER_INLINE, (struct chan*[]) { &c1, &c2, 0 },
+                       (uint32_t[]) { 0, IWN_POLLBLOCKING }));
+  IWN_ASSERT(c1.num_read == NUM_WRITES);
+  IWN_ASSERT(c2.num_read == NUM_WRITES);
+  IWN_ASSERT(c1.num_reactor > 0);
+  IWN_ASSERT(c2.num_reactor == 0);
+
+  // Regular poller: only IWN_POLLINLINE handlers are executed by the reactor
+  struct chan c3 = { 0 }, c4 = { 0 };
+  RCC(rc, finish, _run(0, (struct chan*[]) { &c3, &c4, 0 },
+                       (uint32_t[]) { IWN_POLLINLINE, 0 }));
+  IWN_ASSERT(c3.num_read == NUM_WRITES);
+  IWN_ASSERT(c4.num_read == NUM_WRITES);
+  IWN_ASSERT(c3.num_reactor > 0);
+  IWN_ASSERT(c4.num_reactor == 0);
+
+finish:
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#define NUM_PAIRS        16
+#define NUM_ROUNDS       50
+#define NUM_POLL_THREADS 4
+
+static int pairs[NUM_PAIRS][2];
+static atomic_int num_read;
+static atomic_int num_disposed;
+static struct iwn_poller *poller;
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t poll_threads[NUM_POLL_THREADS];
+static int num_poll_threads;
+
+static iwrc _make_non_blocking(int fd) {
+  int rci, flags;
+  while ((flags = fcntl(fd, F_GETFL, 0)) == -1 && errno == EINTR);
+  if (flags == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  while ((rci = fcntl(fd, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR);
+  if (rci == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  return 0;
+}
+
+static void _poll_thread_register(void) {
+  pthread_t self = pthread_self();
+  pthread_mutex_lock(&mtx);
+  for (int i = 0; i < num_poll_threads; ++i) {
+    if (pthread_equal(poll_threads[i], self)) {
+      pthread_mutex_unlock(&mtx);
+      return;
+    }
+  }
+  IWN_ASSERT(num_poll_threads < NUM_POLL_THREADS);
+  if (num_poll_threads < NUM_POLL_THREADS) {
+    poll_threads[num_poll_threads++] = self;
+  }
+  pthread_mutex_unlock(&mtx);
+}
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[256];
+  ssize_t len;
+  // Inline handler is executed by the poll thread harvested the event,
+  // it holds the thread for a while to let other poll threads take the next events.
+  _poll_thread_register();
+  usleep(1000);
+  while ((len = read(t->fd, buf, sizeof(buf))) > 0) {
+    num_read += len;
+  }
+  IWN_ASSERT(len == -1 && errno == EAGAIN);
+  return IWN_POLLIN;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  int idx = (int) (intptr_t) t->user_data;
+  close(pairs[idx][1]);
+  ++num_disposed;
+}
+
+static void* _producer(void *d) {
+  for (int r = 0; r < NUM_ROUNDS; ++r) {
+    for (int i = 0; i < NUM_PAIRS; ++i) {
+      IWN_ASSERT(write(pairs[i][1], "x", 1) == 1);
+    }
+    usleep(1000);
+  }
+  for (int i = 0; i < 1000 && num_read < NUM_ROUNDS * NUM_PAIRS; ++i) {
+    usleep(10000);
+  }
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    iwn_poller_remove(poller, pairs[i][0]);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t producer;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .one_shot_events = 1,
+    .num_poll_threads = NUM_POLL_THREADS,
+  }, &poller));
+
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    int rci = socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+    IWN_ASSERT_FATAL(rci == 0);
+    RCC(rc, finish, _make_non_blocking(pairs[i][0]));
+    RCC(rc, finish, _make_non_blocking(pairs[i][1]));
+    RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = pairs[i][0],
+      .user_data = (void*) (intptr_t) i,
+      .on_ready = _on_ready,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLONESHOT | IWN_POLLINLINE,
+      .poller = poller
+    }));
+  }
+
+  pthread_create(&producer, 0, _producer, 0);
+  iwn_poller_poll(poller);
+  pthread_join(producer, 0);
+
+  IWN_ASSERT(num_read == NUM_ROUNDS * NUM_PAIRS);
+  IWN_ASSERT(num_disposed == NUM_PAIRS);
+  IWN_ASSERT(num_poll_threads > 1);
+  IWN_ASSERT(!iwn_poller_alive(poller));
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#define NUM_PAIRS     16
+#define NUM_PRODUCERS 2
+#define NUM_WRITES    10000
+
+static int pairs[NUM_PAIRS][2];
+static atomic_int num_written;
+static atomic_int num_read;
+static atomic_int num_out;
+static atomic_int num_disposed;
+static struct iwn_poller *poller;
+
+static iwrc _make_non_blocking(int fd) {
+  int rci, flags;
+  while ((flags = fcntl(fd, F_GETFL, 0)) == -1 && errno == EINTR);
+  if (flags == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  while ((rci = fcntl(fd, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR);
+  if (rci == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  return 0;
+}
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[4];
+  ssize_t len;
+  if (events & IWN_POLLOUT) {
+    ++num_out;
+  }
+  // Socket is not read out here, the rest of data is read by subsequent dispatches
+  // since readiness is kept by the poller until EAGAIN is reported.
+  for (int i = 0; i < 2; ++i) {
+    len = read(t->fd, buf, sizeof(buf));
+    if (len > 0) {
+      num_read += len;
+    } else {
+      IWN_ASSERT(len == -1 && errno == EAGAIN);
+      iwn_poller_edge_drained(t->poller, t->fd, IWN_POLLIN);
+      break;
+    }
+  }
+  return IWN_POLLIN;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  int idx = (int) (intptr_t) t->user_data;
+  close(pairs[idx][1]);
+  ++num_disposed;
+}
+
+static void* _producer(void *d) {
+  unsigned seed = (unsigned) (intptr_t) d;
+  for (int i = 0; i < NUM_WRITES; ++i) {
+    int idx = rand_r(&seed) % NUM_PAIRS;
+    while (write(pairs[idx][1], "x", 1) != 1) {
+      IWN_ASSERT_FATAL(errno == EAGAIN);
+      usleep(100);
+    }
+    ++num_written;
+  }
+  return 0;
+}
+
+static void* _controller(void *d) {
+  pthread_t threads[NUM_PRODUCERS];
+  for (int i = 0; i < NUM_PRODUCERS; ++i) {
+    pthread_create(&threads[i], 0, _producer, (void*) (intptr_t) (i + 1));
+  }
+  for (int i = 0; i < NUM_PRODUCERS; ++i) {
+    pthread_join(threads[i], 0);
+  }
+  for (int i = 0; i < 1000 && num_read < num_written; ++i) {
+    usleep(10000);
+  }
+  // Sockets are writable, readiness is known to the poller
+  // so armed events are dispatched right away.
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    IWN_ASSERT(iwn_poller_arm_events(poller, pairs[i][0], IWN_POLLOUT) == 0);
+  }
+  for (int i = 0; i < 1000 && num_out < NUM_PAIRS; ++i) {
+    usleep(10000);
+  }
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    iwn_poller_remove(poller, pairs[i][0]);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t controller;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create(2, 4, &poller));
+
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    int rci = socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+    IWN_ASSERT_FATAL(rci == 0);
+    RCC(rc, finish, _make_non_blocking(pairs[i][0]));
+    RCC(rc, finish, _make_non_blocking(pairs[i][1]));
+    RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = pairs[i][0],
+      .user_data = (void*) (intptr_t) i,
+      .on_ready = _on_ready,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLPERSIST,
+      .poller = poller
+    }));
+  }
+
+  pthread_create(&controller, 0, _controller, 0);
+  iwn_poller_poll(poller);
+  pthread_join(controller, 0);
+
+  IWN_ASSERT(num_written == NUM_PRODUCERS * NUM_WRITES);
+  IWN_ASSERT(num_read == num_written);
+  IWN_ASSERT(num_out == NUM_PAIRS);
+  IWN_ASSERT(num_disposed == NUM_PAIRS);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
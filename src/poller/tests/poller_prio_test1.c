@@ -0,0 +1,90 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+#include "iwn_scheduler.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#define NUM_BG_TASKS 200
+
+static struct iwn_poller *poller;
+static atomic_int num_bg_done;
+static atomic_int num_timers;
+static atomic_llong prio_done_ms;
+static atomic_llong normal_done_ms;
+
+static int64_t _time_ms(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+static void _bg_task(void *arg) {
+  usleep(2000);
+  ++num_bg_done;
+}
+
+static void _prio_task(void *arg) {
+  prio_done_ms = _time_ms();
+}
+
+static void _normal_task(void *arg) {
+  normal_done_ms = _time_ms();
+}
+
+static void _on_timer(void *arg) {
+  ++num_timers;
+  if (num_timers == 2) {
+    iwn_poller_shutdown_request(poller);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 1,
+    .num_priority_threads = 1,
+    .num_background_threads = 1,
+    .flags = IWN_POLLER_POLL_NO_FDS,
+  }, &poller));
+
+  // Storm of background jobs doesn't delay other lanes
+  for (int i = 0; i < NUM_BG_TASKS; ++i) {
+    RCC(rc, finish, iwn_poller_task_prio(poller, _bg_task, 0, IWN_POLLER_PRIO_BACKGROUND));
+  }
+  int64_t ts = _time_ms();
+  RCC(rc, finish, iwn_poller_task_prio(poller, _prio_task, 0, IWN_POLLER_PRIO_HIGH));
+  RCC(rc, finish, iwn_poller_task(poller, _normal_task, 0));
+
+  for (int i = 0; i < 1000 && (!prio_done_ms || !normal_done_ms); ++i) {
+    usleep(1000);
+  }
+  IWN_ASSERT(prio_done_ms && prio_done_ms - ts < 100);
+  IWN_ASSERT(normal_done_ms && normal_done_ms - ts < 100);
+  IWN_ASSERT(num_bg_done < NUM_BG_TASKS);
+
+  // Timers are executed in lane of their priority
+  RCC(rc, finish, iwn_schedule(&(struct iwn_scheduler_spec) {
+    .task_fn = _on_timer,
+    .poller = poller,
+    .timeout_ms = 10,
+    .prio = IWN_POLLER_PRIO_HIGH
+  }));
+  RCC(rc, finish, iwn_schedule(&(struct iwn_scheduler_spec) {
+    .task_fn = _on_timer,
+    .poller = poller,
+    .timeout_ms = 20,
+    .prio = IWN_POLLER_PRIO_BACKGROUND
+  }));
+  iwn_poller_poll(poller);
+  IWN_ASSERT(num_timers == 2);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  IWN_ASSERT(num_bg_done == NUM_BG_TASKS);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
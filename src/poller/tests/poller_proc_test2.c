@@ -0,0 +1,117 @@
+#include "iwn_tests.h"
+#include "iwn_proc.h"
+
+#include <sys/wait.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define NUM_PROCS 64
+
+static struct iwn_poller *poller;
+static atomic_int num_exited;
+static atomic_int num_codes_ok;
+static atomic_int num_forks;
+
+static void* _poller_worker(void *arg) {
+  iwn_poller_poll(poller);
+  return 0;
+}
+
+static void _on_exit(const struct iwn_proc_ctx *ctx) {
+  int expected = (int) (intptr_t) ctx->user_data;
+  if (WIFEXITED(ctx->wstatus) && WEXITSTATUS(ctx->wstatus) == expected) {
+    ++num_codes_ok;
+  }
+  ++num_exited;
+}
+
+static void _on_fork(const struct iwn_proc_ctx *ctx, pid_t pid) {
+  if (pid > 0) {
+    ++num_forks;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t thr;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .flags = IWN_POLLER_POLL_NO_FDS,
+  }, &poller));
+  pthread_create(&thr, 0, _poller_worker, 0);
+
+  // Many short living children are reaped without blocking any worker thread
+  for (int i = 0; i < NUM_PROCS; ++i) {
+    pid_t pid;
+    char code[16];
+    snprintf(code, sizeof(code), "exit %d", i % 8);
+    RCC(rc, finish, iwn_proc_spawn(&(struct iwn_proc_spec) {
+      .poller = poller,
+      .path = "/bin/sh",
+      .args = (const char*[]) { "-c", code, 0 },
+      .user_data = (void*) (intptr_t) (i % 8),
+      .on_exit = _on_exit,
+    }, &pid));
+  }
+
+  // Child with on_fork handler is spawned by fork()
+  pid_t pid;
+  RCC(rc, finish, iwn_proc_spawn(&(struct iwn_proc_spec) {
+    .poller = poller,
+    .path = "/bin/sh",
+    .args = (const char*[]) { "-c", "exit 3", 0 },
+    .user_data = (void*) (intptr_t) 3,
+    .on_exit = _on_exit,
+    .on_fork = _on_fork,
+    .parent_death_signal = SIGKILL,
+  }, &pid));
+
+  // Exec errors are reported by spawn
+  iwrc rc2 = iwn_proc_spawn(&(struct iwn_proc_spec) {
+    .poller = poller,
+    .path = "./not_exists",
+    .on_exit = _on_exit,
+    .parent_death_signal = SIGKILL,
+  }, &pid);
+  IWN_ASSERT(rc2);
+  IWN_ASSERT(pid == -1);
+
+  // Executable is searched using PATH of the child environment
+  RCC(rc, finish, iwn_proc_spawn(&(struct iwn_proc_spec) {
+    .poller = poller,
+    .path = "sh",
+    .args = (const char*[]) { "-c", "exit 5", 0 },
+    .env = (const char*[]) { "PATH=/bin", 0 },
+    .find_executable_in_path = true,
+    .user_data = (void*) (intptr_t) 5,
+    .on_exit = _on_exit,
+  }, &pid));
+
+  rc2 = iwn_proc_spawn(&(struct iwn_proc_spec) {
+    .poller = poller,
+    .path = "sh",
+    .args = (const char*[]) { "-c", "exit 5", 0 },
+    .env = (const char*[]) { "PATH=/not_exists", 0 },
+    .find_executable_in_path = true,
+    .on_exit = _on_exit,
+  }, &pid);
+  IWN_ASSERT(rc2);
+  IWN_ASSERT(pid == -1);
+
+  iwn_proc_wait_all();
+  IWN_ASSERT(num_forks == 1);
+  IWN_ASSERT(num_exited == NUM_PROCS + 2);
+  IWN_ASSERT(num_codes_ok == NUM_PROCS + 2);
+
+  iwn_poller_shutdown_request(poller);
+  pthread_join(thr, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  iwn_proc_dispose();
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#include "iwn_tests.h"
+#include "iwn_proc.h"
+
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define NUM_LINES 2000
+
+static struct iwn_poller *poller;
+static pthread_t poller_thr;
+static int num_lines;
+static int num_lines_bad;
+static size_t num_bytes;
+
+static void* _poller_worker(void *arg) {
+  iwn_poller_poll(poller);
+  return 0;
+}
+
+static void _on_line(const struct iwn_proc_ctx *ctx, const char *buf, size_t len) {
+  char expected[32];
+  int elen = snprintf(expected, sizeof(expected), "line%d", num_lines++);
+  if (len != elen || memcmp(buf, expected, len) != 0) {
+    ++num_lines_bad;
+  }
+}
+
+static void _on_chunk(const struct iwn_proc_ctx *ctx, const char *buf, size_t len) {
+  num_bytes += len;
+}
+
+static iwrc _spawn_wait(const struct iwn_proc_spec *spec) {
+  iwrc rc = 0;
+  pid_t pid;
+  RCC(rc, finish, iwn_poller_create(1, 1, &poller));
+  struct iwn_proc_spec s = *spec;
+  s.poller = poller;
+  RCC(rc, finish, iwn_proc_spawn(&s, &pid));
+  pthread_create(&poller_thr, 0, _poller_worker, 0);
+  iwn_proc_wait(pid);
+  pthread_join(poller_thr, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  char script[128];
+  iwlog_init();
+
+  snprintf(script, sizeof(script),
+           "i=0; while [ $i -lt %d ]; do echo line$i; i=$((i+1)); done", NUM_LINES);
+
+  // Lines are delivered as views into small read buffer
+  RCC(rc, finish, _spawn_wait(&(struct iwn_proc_spec) {
+    .path = "/bin/sh",
+    .args = (const char*[]) { "-c", script, 0 },
+    .on_stdout = _on_line,
+    .read_buf_size = 16,
+    .output_lines = true,
+  }));
+  IWN_ASSERT(num_lines == NUM_LINES);
+  IWN_ASSERT(num_lines_bad == 0);
+
+  // Big output read by chunks
+  RCC(rc, finish, _spawn_wait(&(struct iwn_proc_spec) {
+    .path = "/bin/sh",
+    .args = (const char*[]) { "-c", "head -c 1000000 /dev/zero", 0 },
+    .on_stdout = _on_chunk,
+  }));
+  IWN_ASSERT(num_bytes == 1000000);
+
+  // Output forwarded into file
+  char path[] = "/tmp/poller_proc_test3XXXXXX";
+  int fd = mkstemp(path);
+  IWN_ASSERT_FATAL(fd > -1);
+  unlink(path);
+  RCC(rc, finish, _spawn_wait(&(struct iwn_proc_spec) {
+    .path = "/bin/sh",
+    .args = (const char*[]) { "-c", "head -c 1000000 /dev/zero; echo err >&2", 0 },
+    .forward_stdout_fd = fd,
+    .forward_stderr_fd = fd,
+  }));
+  struct stat st;
+  IWN_ASSERT(fstat(fd, &st) == 0);
+  IWN_ASSERT(st.st_size == 1000000 + sizeof("err") - 1 + 1);
+  close(fd);
+
+finish:
+  iwn_proc_dispose();
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
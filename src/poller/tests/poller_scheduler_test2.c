@@ -0,0 +1,74 @@
+#include "iwn_tests.h"
+#include "iwn_utils.h"
+#include "iwn_scheduler.h"
+
+#include <stdlib.h>
+
+#define NUM_TASKS 10000
+
+struct task {
+  int     handle;
+  int64_t scheduled_at;
+  int     timeout_ms;
+};
+
+static struct task tasks[NUM_TASKS];
+static atomic_int num_executed;
+static atomic_int num_cancelled;
+static atomic_int num_early;
+
+static void _on_task(void *arg) {
+  struct task *t = arg;
+  int64_t ts;
+  iwn_ts(&ts);
+  if (ts - t->scheduled_at < t->timeout_ms - 1) {
+    ++num_early;
+  }
+  ++num_executed;
+}
+
+static void _on_cancel(void *arg) {
+  ++num_cancelled;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  struct iwn_poller *poller;
+  unsigned seed = 1;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .num_shards = 2,
+  }, &poller));
+
+  for (int i = 0; i < NUM_TASKS; ++i) {
+    struct task *t = &tasks[i];
+    t->timeout_ms = 50 + rand_r(&seed) % 200;
+    iwn_ts(&t->scheduled_at);
+    RCC(rc, finish, iwn_schedule2(&(struct iwn_scheduler_spec) {
+      .poller = poller,
+      .task_fn = _on_task,
+      .on_cancel = _on_cancel,
+      .user_data = t,
+      .timeout_ms = t->timeout_ms,
+    }, &t->handle));
+    IWN_ASSERT(t->handle < -1);
+    IWN_ASSERT(iwn_poller_fd_is_managed(poller, t->handle));
+  }
+
+  // Cancel every odd task
+  for (int i = 1; i < NUM_TASKS; i += 2) {
+    iwn_poller_remove(poller, tasks[i].handle);
+  }
+
+  iwn_poller_poll(poller);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  IWN_ASSERT(num_executed == NUM_TASKS / 2);
+  IWN_ASSERT(num_cancelled == NUM_TASKS / 2);
+  IWN_ASSERT(num_early == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
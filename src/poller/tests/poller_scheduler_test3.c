@@ -0,0 +1,121 @@
+#include "iwn_tests.h"
+#include "iwn_scheduler.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#define PERIOD_MS 20
+#define NUM_RUNS  20
+#define SLACK_MS  50
+
+static struct iwn_poller *poller;
+static int64_t runs_ms[NUM_RUNS];
+static atomic_int num_runs;
+static atomic_int run_handle;
+static atomic_int cancel_handle;
+static atomic_int num_cancel_runs;
+static atomic_int num_cancel_runs_before;
+static atomic_int num_slack_runs;
+static atomic_int num_slack_misaligned;
+static atomic_int num_cancelled;
+
+static int64_t _time_ms(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+static void _on_run(void *arg) {
+  int n = num_runs++;
+  if (n < NUM_RUNS) {
+    runs_ms[n] = _time_ms();
+  }
+  if (n == 5) {
+    num_cancel_runs_before = num_cancel_runs;
+    iwn_poller_remove(poller, cancel_handle);
+  } else if (n == NUM_RUNS - 1) {
+    // Periodic task is stopped by removal of its handle
+    iwn_poller_remove(poller, run_handle);
+  }
+}
+
+static void _on_run_dispose(void *arg) {
+  iwn_poller_shutdown_request(poller);
+}
+
+static void _on_slack_run(void *arg) {
+  if (_time_ms() % SLACK_MS > SLACK_MS / 2) {
+    ++num_slack_misaligned;
+  }
+  ++num_slack_runs;
+}
+
+static void _on_cancel_run(void *arg) {
+  ++num_cancel_runs;
+}
+
+static void _on_cancel(void *arg) {
+  ++num_cancelled;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  int handle;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .flags = IWN_POLLER_POLL_NO_FDS,
+  }, &poller));
+
+  IWN_ASSERT(iwn_schedule_periodic(&(struct iwn_scheduler_spec) {
+    .poller = poller,
+    .task_fn = _on_run,
+  }, 0) == IW_ERROR_INVALID_ARGS);
+
+  RCC(rc, finish, iwn_schedule_periodic(&(struct iwn_scheduler_spec) {
+    .poller = poller,
+    .task_fn = _on_run,
+    .on_cancel = _on_cancel,
+    .on_dispose = _on_run_dispose,
+    .period_ms = PERIOD_MS,
+  }, &handle));
+  IWN_ASSERT(handle < -1);
+  run_handle = handle;
+
+  RCC(rc, finish, iwn_schedule_periodic(&(struct iwn_scheduler_spec) {
+    .poller = poller,
+    .task_fn = _on_slack_run,
+    .period_ms = 10,
+    .slack_ms = SLACK_MS,
+  }, 0));
+
+  RCC(rc, finish, iwn_schedule_periodic(&(struct iwn_scheduler_spec) {
+    .poller = poller,
+    .task_fn = _on_cancel_run,
+    .on_cancel = _on_cancel,
+    .period_ms = 10,
+    .timeout_ms = 1,
+  }, &handle));
+  cancel_handle = handle;
+
+  iwn_poller_poll(poller);
+
+  IWN_ASSERT(num_runs == NUM_RUNS);
+  for (int i = 1; i < NUM_RUNS; ++i) {
+    // Runs are aligned to the schedule of the first run, delays are not accumulated
+    int64_t drift = runs_ms[i] - runs_ms[0] - i * PERIOD_MS;
+    IWN_ASSERT(drift > -PERIOD_MS / 2 && drift < PERIOD_MS / 2);
+  }
+  IWN_ASSERT(num_cancel_runs_before > 0);
+  IWN_ASSERT(num_cancel_runs <= num_cancel_runs_before + 1);
+  IWN_ASSERT(num_cancelled == 2);
+  IWN_ASSERT(num_slack_runs > 0);
+  IWN_ASSERT(num_slack_runs <= NUM_RUNS * PERIOD_MS / SLACK_MS + 2);
+  IWN_ASSERT(num_slack_misaligned == 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
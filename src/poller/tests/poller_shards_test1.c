@@ -0,0 +1,108 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+
+#define NUM_PIPES 16
+
+static int fds[NUM_PIPES][2];
+static struct iwn_poller *shards[NUM_PIPES];
+static atomic_int num_read;
+static atomic_int num_disposed;
+static struct iwn_poller *poller;
+
+static iwrc _make_non_blocking(int fd) {
+  int rci, flags;
+  while ((flags = fcntl(fd, F_GETFL, 0)) == -1 && errno == EINTR);
+  if (flags == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  while ((rci = fcntl(fd, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR);
+  if (rci == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  return 0;
+}
+
+static void _write_task(void *arg) {
+  int idx = (int) (intptr_t) arg;
+  IWN_ASSERT(write(fds[idx][1], "test", sizeof("test")) == sizeof("test"));
+}
+
+static int64_t _on_ready_read(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[sizeof("test")];
+  int idx = (int) (intptr_t) t->user_data;
+  int rci = read(t->fd, buf, sizeof(buf));
+  IWN_ASSERT(rci == sizeof(buf));
+  IWN_ASSERT(strncmp(buf, "test", sizeof(buf)) == 0);
+  IWN_ASSERT(t->poller != poller);
+  IWN_ASSERT(iwn_poller_fd_is_managed(poller, t->fd));
+  IWN_ASSERT(iwn_poller_fd_is_managed(t->poller, t->fd));
+  shards[idx] = t->poller;
+  ++num_read;
+  return -1;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  int idx = (int) (intptr_t) t->user_data;
+  close(fds[idx][1]);
+  ++num_disposed;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 4,
+    .num_shards = 4,
+  }, &poller));
+
+  for (int i = 0; i < NUM_PIPES; ++i) {
+    int rci = pipe(fds[i]);
+    IWN_ASSERT_FATAL(rci == 0);
+    RCC(rc, finish, _make_non_blocking(fds[i][0]));
+    RCC(rc, finish, _make_non_blocking(fds[i][1]));
+    RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = fds[i][0],
+      .user_data = (void*) (intptr_t) i,
+      .on_ready = _on_ready_read,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLET,
+      .poller = poller
+    }));
+  }
+
+  for (int i = 0; i < NUM_PIPES; ++i) {
+    RCC(rc, finish, iwn_poller_task(poller, _write_task, (void*) (intptr_t) i));
+  }
+
+  iwn_poller_poll(poller);
+
+  IWN_ASSERT(num_read == NUM_PIPES);
+  IWN_ASSERT(num_disposed == NUM_PIPES);
+
+  int num_shards = 0;
+  for (int i = 0; i < NUM_PIPES; ++i) {
+    bool seen = false;
+    for (int j = 0; j < i; ++j) {
+      if (shards[j] == shards[i]) {
+        seen = true;
+        break;
+      }
+    }
+    if (!seen) {
+      ++num_shards;
+    }
+  }
+  IWN_ASSERT(num_shards > 1);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
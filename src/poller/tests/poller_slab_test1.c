@@ -0,0 +1,77 @@
+#include "iwn_tests.h"
+#include "iwn_slab.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define NUM_THREADS 4
+#define NUM_ITERATIONS 10000
+
+struct obj {
+  void *next;
+  char  data[120];
+};
+
+static struct iwn_slab slab = IWN_SLAB_INITIALIZER("test", sizeof(struct obj), 8);
+
+static void* _worker(void *d) {
+  struct obj *objs[4];
+  for (int i = 0; i < NUM_ITERATIONS; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      objs[j] = iwn_slab_alloc(&slab);
+      IWN_ASSERT_FATAL(objs[j]);
+      IWN_ASSERT(objs[j]->next == 0 && objs[j]->data[0] == 0 && objs[j]->data[119] == 0);
+      memset(objs[j], 0xff, sizeof(*objs[j]));
+    }
+    for (int j = 0; j < 4; ++j) {
+      iwn_slab_free(&slab, objs[j]);
+    }
+  }
+  return 0;
+}
+
+static void _visitor(const char *name, const struct iwn_slab_stats *stats, void *op) {
+  if (strcmp(name, "test") == 0) {
+    ++*(int*) op;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  struct iwn_slab_stats stats;
+  pthread_t threads[NUM_THREADS];
+  iwlog_init();
+
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    pthread_create(&threads[i], 0, _worker, 0);
+  }
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    pthread_join(threads[i], 0);
+  }
+
+  iwn_slab_stats(&slab, &stats);
+  IWN_ASSERT(stats.hits + stats.misses == NUM_THREADS * NUM_ITERATIONS * 4);
+  IWN_ASSERT(stats.misses <= NUM_THREADS * NUM_ITERATIONS);
+  IWN_ASSERT(stats.hits > stats.misses);
+  IWN_ASSERT(stats.cached > 0 && stats.cached <= NUM_THREADS * 8);
+
+  // Per stripe capacity is respected
+  struct obj *objs[16];
+  for (int i = 0; i < 16; ++i) {
+    objs[i] = iwn_slab_alloc(&slab);
+  }
+  for (int i = 0; i < 16; ++i) {
+    iwn_slab_free(&slab, objs[i]);
+  }
+  iwn_slab_stats(&slab, &stats);
+  IWN_ASSERT(stats.releases >= 8);
+
+  int found = 0;
+  iwn_slabs_stats_visit(_visitor, &found);
+  IWN_ASSERT(found == 1);
+
+  iwn_slab_purge(&slab);
+  iwn_slab_stats(&slab, &stats);
+  IWN_ASSERT(stats.cached == 0);
+
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#define NUM_PAIRS     64
+#define NUM_PRODUCERS 4
+#define NUM_WRITES    20000
+
+static int pairs[NUM_PAIRS][2];
+static atomic_int num_written;
+static atomic_int num_read;
+static atomic_int num_probed;
+static atomic_int num_disposed;
+static struct iwn_poller *poller;
+
+static iwrc _make_non_blocking(int fd) {
+  int rci, flags;
+  while ((flags = fcntl(fd, F_GETFL, 0)) == -1 && errno == EINTR);
+  if (flags == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  while ((rci = fcntl(fd, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR);
+  if (rci == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  return 0;
+}
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[256];
+  ssize_t len;
+  while ((len = read(t->fd, buf, sizeof(buf))) > 0) {
+    num_read += len;
+  }
+  IWN_ASSERT(len == -1 && errno == EAGAIN);
+  return 0;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  int idx = (int) (intptr_t) t->user_data;
+  close(pairs[idx][1]);
+  ++num_disposed;
+}
+
+static void _probe(struct iwn_poller *p, void *slot_user_data, void *fn_user_data) {
+  IWN_ASSERT(slot_user_data == fn_user_data);
+  ++num_probed;
+}
+
+static void* _producer(void *d) {
+  unsigned seed = (unsigned) (intptr_t) d;
+  for (int i = 0; i < NUM_WRITES; ++i) {
+    int idx = rand_r(&seed) % NUM_PAIRS;
+    if (write(pairs[idx][1], "x", 1) == 1) {
+      ++num_written;
+    }
+    IWN_ASSERT(iwn_poller_probe(poller, pairs[idx][0], _probe, (void*) (intptr_t) idx));
+    IWN_ASSERT(iwn_poller_arm_events(poller, pairs[idx][0], IWN_POLLIN) == 0);
+  }
+  return 0;
+}
+
+static void* _controller(void *d) {
+  pthread_t threads[NUM_PRODUCERS];
+  for (int i = 0; i < NUM_PRODUCERS; ++i) {
+    pthread_create(&threads[i], 0, _producer, (void*) (intptr_t) (i + 1));
+  }
+  for (int i = 0; i < NUM_PRODUCERS; ++i) {
+    pthread_join(threads[i], 0);
+  }
+  for (int i = 0; i < 1000 && num_read < num_written; ++i) {
+    usleep(10000);
+  }
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    iwn_poller_remove(poller, pairs[i][0]);
+    IWN_ASSERT(!iwn_poller_fd_is_managed(poller, pairs[i][0]));
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t controller;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create(4, 4, &poller));
+
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    int rci = socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+    IWN_ASSERT_FATAL(rci == 0);
+    RCC(rc, finish, _make_non_blocking(pairs[i][0]));
+    RCC(rc, finish, _make_non_blocking(pairs[i][1]));
+    RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = pairs[i][0],
+      .user_data = (void*) (intptr_t) i,
+      .on_ready = _on_ready,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLONESHOT,
+      .poller = poller
+    }));
+    IWN_ASSERT(iwn_poller_fd_is_managed(poller, pairs[i][0]));
+  }
+
+  pthread_create(&controller, 0, _controller, 0);
+  iwn_poller_poll(poller);
+  pthread_join(controller, 0);
+
+  IWN_ASSERT(num_written == NUM_PRODUCERS * NUM_WRITES);
+  IWN_ASSERT(num_read == num_written);
+  IWN_ASSERT(num_probed == NUM_PRODUCERS * NUM_WRITES);
+  IWN_ASSERT(num_disposed == NUM_PAIRS);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+#include "iwn_tests.h"
+#include "iwn_poller.h"
+#include "iwn_scheduler.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#define NUM_WRITES 100
+
+static struct iwn_poller *poller;
+static int fds[2];
+static atomic_int num_read;
+static atomic_int num_timers;
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[16];
+  ssize_t len;
+  while ((len = read(t->fd, buf, sizeof(buf))) > 0) {
+    num_read += len;
+  }
+  return 0;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  close(fds[1]);
+  close(t->fd);
+}
+
+static void _on_timer(void *arg) {
+  ++num_timers;
+}
+
+static void* _producer(void *d) {
+  for (int i = 0; i < NUM_WRITES; ++i) {
+    IWN_ASSERT(write(fds[1], "x", 1) == 1);
+    usleep(100);
+  }
+  for (int i = 0; i < 1000 && (num_read < NUM_WRITES || num_timers < 1); ++i) {
+    usleep(1000);
+  }
+  iwn_poller_remove(poller, fds[0]);
+  return 0;
+}
+
+static uint64_t _buckets_sum(const struct iwn_poller_histogram *h) {
+  uint64_t sum = 0;
+  for (int i = 0; i < IWN_POLLER_HISTOGRAM_BUCKETS; ++i) {
+    sum += h->buckets[i];
+  }
+  return sum;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t producer;
+  struct iwn_poller_stats stats;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .one_shot_events = 4,
+    .flags = IWN_POLLER_STATS,
+  }, &poller));
+
+  IWN_ASSERT_FATAL(pipe(fds) == 0);
+  IWN_ASSERT_FATAL(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+  RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+    .fd = fds[0],
+    .on_ready = _on_ready,
+    .on_dispose = _on_dispose,
+    .events = IWN_POLLIN,
+    .events_mod = IWN_POLLONESHOT,
+    .poller = poller
+  }));
+  RCC(rc, finish, iwn_schedule(&(struct iwn_scheduler_spec) {
+    .task_fn = _on_timer,
+    .poller = poller,
+    .timeout_ms = 10
+  }));
+
+  iwn_poller_stats(poller, &stats);
+  IWN_ASSERT(stats.fds == 2);
+
+  pthread_create(&producer, 0, _producer, 0);
+  iwn_poller_poll(poller);
+  pthread_join(producer, 0);
+
+  IWN_ASSERT(num_read == NUM_WRITES);
+  IWN_ASSERT(num_timers == 1);
+
+  // Poll loop may exit before workers complete the last dispatched handlers
+  for (int i = 0; i < 1000; ++i) {
+    iwn_poller_stats(poller, &stats);
+    if (stats.handler_time.count == stats.dispatches + stats.inline_dispatches + stats.timeouts) {
+      break;
+    }
+    usleep(1000);
+  }
+  IWN_ASSERT(stats.polls > 0);
+  IWN_ASSERT(stats.events > 0 && stats.events <= stats.polls * 4);
+  IWN_ASSERT(stats.dispatches + stats.inline_dispatches >= stats.events - stats.updates);
+  // Only poller command eventfd is dispatched inline, pipe handler is executed by workers
+  IWN_ASSERT(stats.dispatches > 0);
+  IWN_ASSERT(stats.rearms > 0);
+  IWN_ASSERT(stats.timeouts == 1);
+  IWN_ASSERT(stats.fds == 0);
+  IWN_ASSERT(stats.queue_size == 0);
+  IWN_ASSERT(stats.handler_time.count > 0);
+  IWN_ASSERT(stats.handler_time.count == _buckets_sum(&stats.handler_time));
+  IWN_ASSERT(stats.handler_time.max * stats.handler_time.count >= stats.handler_time.sum);
+  IWN_ASSERT(stats.dispatch_delay.count == stats.dispatches + stats.inline_dispatches);
+  IWN_ASSERT(stats.dispatch_delay.count == _buckets_sum(&stats.dispatch_delay));
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#include "iwn_tests.h"
+#include "iwn_utils.h"
+#include "iwn_poller.h"
+#include "iwn_scheduler.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#define NUM_PAIRS  32
+#define NUM_ROUNDS 200
+
+static int pairs[NUM_PAIRS][2];
+static atomic_int num_read;
+static atomic_int num_disposed;
+static atomic_int num_scheduled;
+static struct iwn_poller *poller;
+
+static iwrc _make_non_blocking(int fd) {
+  int rci, flags;
+  while ((flags = fcntl(fd, F_GETFL, 0)) == -1 && errno == EINTR);
+  if (flags == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  while ((rci = fcntl(fd, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR);
+  if (rci == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  return 0;
+}
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[64];
+  ssize_t len;
+  while ((len = read(t->fd, buf, sizeof(buf))) > 0) {
+    num_read += (int) len;
+  }
+  return 0;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  int idx = (int) (intptr_t) t->user_data;
+  close(pairs[idx][1]);
+  ++num_disposed;
+}
+
+static void _on_scheduled(void *arg) {
+  ++num_scheduled;
+}
+
+static bool _wait_for(atomic_int *counter, int value) {
+  for (int i = 0; i < 5000 && *counter < value; ++i) {
+    usleep(1000);
+  }
+  return *counter >= value;
+}
+
+static void* _ctl(void *d) {
+  int expected = 0;
+  for (int r = 0; r < NUM_ROUNDS; ++r) {
+    for (int i = 0; i < NUM_PAIRS; ++i) {
+      IWN_ASSERT(write(pairs[i][1], "x", 1) == 1);
+    }
+    expected += NUM_PAIRS;
+    IWN_ASSERT(_wait_for(&num_read, expected));
+  }
+
+  // Switch the first half of channels to level triggered output, then back
+  for (int i = 0; i < NUM_PAIRS / 2; ++i) {
+    IWN_ASSERT(iwn_poller_arm_events(poller, pairs[i][0], IWN_POLLIN | IWN_POLLOUT) == 0);
+    IWN_ASSERT(iwn_poller_arm_events(poller, pairs[i][0], IWN_POLLIN) == 0);
+  }
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    IWN_ASSERT(write(pairs[i][1], "x", 1) == 1);
+  }
+  expected += NUM_PAIRS;
+  IWN_ASSERT(_wait_for(&num_read, expected));
+
+  for (int i = 0; i < NUM_PAIRS - 1; ++i) {
+    iwn_poller_remove(poller, pairs[i][0]);
+  }
+  IWN_ASSERT(_wait_for(&num_disposed, NUM_PAIRS - 1));
+
+  // The last channel is removed by its inactivity timeout
+  IWN_ASSERT(_wait_for(&num_disposed, NUM_PAIRS));
+  IWN_ASSERT(_wait_for(&num_scheduled, 1));
+
+  iwn_poller_shutdown_request(poller);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t ctl;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create_by_spec(&(struct iwn_poller_spec) {
+    .num_threads = 2,
+    .flags = IWN_POLLER_URING,
+  }, &poller));
+
+  if (!iwn_poller_uses_uring(poller)) {
+    fprintf(stderr, "io_uring is not available, running on the fallback backend\n");
+  }
+
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    int rci = socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+    IWN_ASSERT_FATAL(rci == 0);
+    RCC(rc, finish, _make_non_blocking(pairs[i][0]));
+    RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = pairs[i][0],
+      .user_data = (void*) (intptr_t) i,
+      .on_ready = _on_ready,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLET,
+      .timeout = i == NUM_PAIRS - 1 ? 2 : 0,
+      .poller = poller
+    }));
+  }
+
+  RCC(rc, finish, iwn_schedule(&(struct iwn_scheduler_spec) {
+    .poller = poller,
+    .task_fn = _on_scheduled,
+    .timeout_ms = 100,
+  }));
+
+  pthread_create(&ctl, 0, _ctl, 0);
+  iwn_poller_poll(poller);
+  pthread_join(ctl, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(rc == 0);
+  IWN_ASSERT(num_read == (NUM_ROUNDS + 1) * NUM_PAIRS);
+  IWN_ASSERT(num_disposed == NUM_PAIRS);
+  IWN_ASSERT(num_scheduled == 1);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,104 @@
+#include "iwn_tests.h"
+#include "iwn_utils.h"
+#include "iwn_poller.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#define NUM_IDLE   16
+#define NUM_ACTIVE 16
+#define NUM_PAIRS  (NUM_IDLE + NUM_ACTIVE + 1)
+
+static int pairs[NUM_PAIRS][2];
+static int64_t disposed_at[NUM_PAIRS];
+static int64_t ts_start;
+static atomic_int num_disposed;
+static struct iwn_poller *poller;
+
+static iwrc _make_non_blocking(int fd) {
+  int rci, flags;
+  while ((flags = fcntl(fd, F_GETFL, 0)) == -1 && errno == EINTR);
+  if (flags == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  while ((rci = fcntl(fd, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR);
+  if (rci == -1) {
+    return iwrc_set_errno(IW_ERROR_ERRNO, errno);
+  }
+  return 0;
+}
+
+static int64_t _on_ready(const struct iwn_poller_task *t, uint32_t events) {
+  char buf[64];
+  while (read(t->fd, buf, sizeof(buf)) > 0);
+  return 0;
+}
+
+static void _on_dispose(const struct iwn_poller_task *t) {
+  int idx = (int) (intptr_t) t->user_data;
+  int64_t ts;
+  iwn_ts(&ts);
+  disposed_at[idx] = ts - ts_start;
+  close(pairs[idx][1]);
+  ++num_disposed;
+}
+
+static void* _writer(void *d) {
+  // Keep active channels busy for 1.5 sec
+  for (int i = 0; i < 15; ++i) {
+    usleep(100000);
+    for (int j = NUM_IDLE; j < NUM_IDLE + NUM_ACTIVE; ++j) {
+      IWN_ASSERT(write(pairs[j][1], "x", 1) == 1);
+    }
+    if (i == 4) {
+      // Shorten timeout of the last channel at 500ms
+      iwn_poller_set_timeout(poller, pairs[NUM_PAIRS - 1][0], 1);
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  iwrc rc = 0;
+  pthread_t writer;
+  iwlog_init();
+
+  RCC(rc, finish, iwn_poller_create(2, 1, &poller));
+  RCC(rc, finish, iwn_ts(&ts_start));
+
+  for (int i = 0; i < NUM_PAIRS; ++i) {
+    int rci = socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+    IWN_ASSERT_FATAL(rci == 0);
+    RCC(rc, finish, _make_non_blocking(pairs[i][0]));
+    RCC(rc, finish, iwn_poller_add(&(struct iwn_poller_task) {
+      .fd = pairs[i][0],
+      .user_data = (void*) (intptr_t) i,
+      .on_ready = _on_ready,
+      .on_dispose = _on_dispose,
+      .events = IWN_POLLIN,
+      .events_mod = IWN_POLLET,
+      .timeout = i < NUM_PAIRS - 1 ? 1 : 60,
+      .poller = poller
+    }));
+  }
+
+  pthread_create(&writer, 0, _writer, 0);
+  iwn_poller_poll(poller);
+  pthread_join(writer, 0);
+
+finish:
+  iwn_poller_destroy(&poller);
+  IWN_ASSERT(num_disposed == NUM_PAIRS);
+  for (int i = 0; i < NUM_IDLE; ++i) {
+    IWN_ASSERT(disposed_at[i] >= 1000 && disposed_at[i] < 1200);
+  }
+  for (int i = NUM_IDLE; i < NUM_IDLE + NUM_ACTIVE; ++i) {
+    IWN_ASSERT(disposed_at[i] >= 2500 && disposed_at[i] < 2800);
+  }
+  IWN_ASSERT(disposed_at[NUM_PAIRS - 1] >= 1500 && disposed_at[NUM_PAIRS - 1] < 1800);
+  IWN_ASSERT(rc == 0);
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
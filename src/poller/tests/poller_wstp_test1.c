@@ -0,0 +1,105 @@
+#include "iwn_tests.h"
+#include "iwn_wstp.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define NUM_THREADS 4
+#define NUM_TASKS   2000
+
+static IWN_WSTP tp;
+static atomic_int num_done;
+static atomic_bool blocked;
+static atomic_int num_started;
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t threads[NUM_THREADS];
+static int num_threads;
+
+static void _thread_register(void) {
+  pthread_t self = pthread_self();
+  pthread_mutex_lock(&mtx);
+  for (int i = 0; i < num_threads; ++i) {
+    if (pthread_equal(threads[i], self)) {
+      pthread_mutex_unlock(&mtx);
+      return;
+    }
+  }
+  IWN_ASSERT(num_threads < NUM_THREADS);
+  if (num_threads < NUM_THREADS) {
+    threads[num_threads++] = self;
+  }
+  pthread_mutex_unlock(&mtx);
+}
+
+static void _task(void *arg) {
+  _thread_register();
+  usleep(100);
+  ++num_done;
+}
+
+static void _root_task(void *arg) {
+  // Tasks are put into the queue of the current worker, others have to steal them
+  for (int i = 0; i < NUM_TASKS; ++i) {
+    IWN_ASSERT(iwn_wstp_schedule(tp, _task, (void*) (intptr_t) i) == 0);
+  }
+}
+
+static void _blocking_task(void *arg) {
+  ++num_started;
+  while (blocked) {
+    usleep(1000);
+  }
+  ++num_done;
+}
+
+static void _test_stealing(void) {
+  iwrc rc = iwn_wstp_start_by_spec(&(struct iwn_wstp_spec) {
+    .num_threads = NUM_THREADS,
+    .thread_name_prefix = "wstp-test-"
+  }, &tp);
+  IWN_ASSERT_FATAL(rc == 0);
+
+  num_done = 0;
+  IWN_ASSERT(iwn_wstp_schedule(tp, _root_task, 0) == 0);
+  for (int i = 0; i < 1000 && num_done < NUM_TASKS; ++i) {
+    usleep(10000);
+  }
+  IWN_ASSERT(num_done == NUM_TASKS);
+  IWN_ASSERT(num_threads > 1);
+  IWN_ASSERT(iwn_wstp_queue_size(tp) == 0);
+  IWN_ASSERT(iwn_wstp_shutdown(&tp, true) == 0);
+  IWN_ASSERT(tp == 0);
+}
+
+static void _test_queue_limit(void) {
+  iwrc rc = iwn_wstp_start_by_spec(&(struct iwn_wstp_spec) {
+    .num_threads = 1,
+    .queue_limit = 2
+  }, &tp);
+  IWN_ASSERT_FATAL(rc == 0);
+
+  num_done = 0;
+  blocked = true;
+  IWN_ASSERT(iwn_wstp_schedule(tp, _blocking_task, 0) == 0);
+  for (int i = 0; i < 1000 && num_started == 0; ++i) {
+    usleep(1000);
+  }
+  // The only worker is blocked, limit is applied to pending tasks
+  IWN_ASSERT(iwn_wstp_schedule(tp, _blocking_task, 0) == 0);
+  IWN_ASSERT(iwn_wstp_schedule(tp, _blocking_task, 0) == 0);
+  IWN_ASSERT(iwn_wstp_schedule(tp, _blocking_task, 0) == IW_ERROR_OVERFLOW);
+  IWN_ASSERT(iwn_wstp_queue_size(tp) == 2);
+  blocked = false;
+
+  // All pending tasks are executed on shutdown
+  IWN_ASSERT(iwn_wstp_shutdown(&tp, true) == 0);
+  IWN_ASSERT(num_done == 3);
+}
+
+int main(int argc, char *argv[]) {
+  iwlog_init();
+  _test_stealing();
+  _test_queue_limit();
+  return iwn_assertions_failed > 0 ? 1 : 0;
+}
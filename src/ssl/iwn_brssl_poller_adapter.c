@@ -111,6 +111,41 @@ static ssize_t _write(struct iwn_poller_adapter *pa, const uint8_t *data, size_t
   }
 }
 
+/// Gathers data into the records of SSL engine, filled records are sent automatically.
+static ssize_t _writev(struct iwn_poller_adapter *pa, const struct iovec *iov, int iovcnt) {
+  struct pa *a = (void*) pa;
+  br_ssl_engine_context *cc = a->eng;
+  ssize_t written = 0;
+
+  for (int i = 0; i < iovcnt; ++i) {
+    const uint8_t *data = iov[i].iov_base;
+    size_t tow = iov[i].iov_len;
+    while (tow > 0) {
+      if (!(br_ssl_engine_current_state(cc) & BR_SSL_SENDAPP)) {
+        goto finish;
+      }
+      size_t blen;
+      unsigned char *buf = br_ssl_engine_sendapp_buf(cc, &blen);
+      if (blen > tow) {
+        blen = tow;
+      }
+      memcpy(buf, data, blen);
+      data += blen;
+      tow -= blen;
+      written += blen;
+      br_ssl_engine_sendapp_ack(cc, blen);
+    }
+  }
+
+finish:
+  if (written == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+  br_ssl_engine_flush(cc, 0);
+  return written;
+}
+
 IW_INLINE void _destroy(struct pa *a) {
   if (a->is_client) {
     VEC_CLEAREXT(a->client.anchors, &free_ta_contents);
@@ -136,8 +171,12 @@ static void _on_dispose(const struct iwn_poller_task *t) {
 static int _write_fd(struct pa *a, const unsigned char *buf, size_t len) {
   while (1) {
     ssize_t wlen = write(a->b.fd, buf, len);
-    if (wlen < 0 && errno == EINTR) {
-      continue;
+    if (wlen < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        iwn_poller_edge_drained(a->b.poller, a->b.fd, IWN_POLLOUT);
+      }
     }
     return (int) wlen;
   }
@@ -146,8 +185,12 @@ static int _write_fd(struct pa *a, const unsigned char *buf, size_t len) {
 static int _read_fd(struct pa *a, unsigned char *buf, size_t len) {
   while (1) {
     ssize_t rlen = read(a->b.fd, buf, len);
-    if (rlen < 0 && errno == EINTR) {
-      continue;
+    if (rlen < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        iwn_poller_edge_drained(a->b.poller, a->b.fd, IWN_POLLIN);
+      }
     }
     return (int) rlen;
   }
@@ -418,6 +461,7 @@ iwrc iwn_brssl_server_poller_adapter(const struct iwn_brssl_server_poller_adapte
   a->b.poller = p;
   a->b.read = _read;
   a->b.write = _write;
+  a->b.writev = _writev;
   a->b.arm = _arm;
   a->b.has_pending_write_bytes = _has_pending_write_bytes;
   a->b.user_data = spec->user_data;
@@ -537,6 +581,7 @@ iwrc iwn_brssl_client_poller_adapter(const struct iwn_brssl_client_poller_adapte
   a->b.poller = p;
   a->b.read = _read;
   a->b.write = _write;
+  a->b.writev = _writev;
   a->b.arm = _arm;
   a->b.user_data = spec->user_data;
   a->b.has_pending_write_bytes = _has_pending_write_bytes;
@@ -0,0 +1,117 @@
+#include "iwn_slab.h"
+
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_CAP_DEFAULT 64
+
+static _Atomic(struct iwn_slab*) _slabs;
+static atomic_uint _stripe_seq;
+
+IW_INLINE struct iwn_slab_stripe* _stripe(struct iwn_slab *s) {
+  static __thread int idx = -1;
+  if (IW_UNLIKELY(idx < 0)) {
+    idx = atomic_fetch_add(&_stripe_seq, 1) % IWN_SLAB_STRIPES;
+  }
+  return &s->stripes[idx];
+}
+
+IW_INLINE void _stripe_lock(struct iwn_slab_stripe *st) {
+  while (atomic_exchange_explicit(&st->lock, true, memory_order_acquire)) {
+    while (atomic_load_explicit(&st->lock, memory_order_relaxed)) {
+      sched_yield();
+    }
+  }
+}
+
+IW_INLINE void _stripe_unlock(struct iwn_slab_stripe *st) {
+  atomic_store_explicit(&st->lock, false, memory_order_release);
+}
+
+static void _slab_register(struct iwn_slab *s) {
+  if (!atomic_exchange(&s->registered, true)) {
+    s->next = atomic_load(&_slabs);
+    while (!atomic_compare_exchange_weak(&_slabs, &s->next, s));
+  }
+}
+
+void* iwn_slab_alloc(struct iwn_slab *s) {
+  struct iwn_slab_stripe *st = _stripe(s);
+  _stripe_lock(st);
+  void *ptr = st->free;
+  if (ptr) {
+    st->free = *(void**) ptr;
+    --st->cached;
+    ++st->hits;
+  } else {
+    ++st->misses;
+  }
+  _stripe_unlock(st);
+
+  if (ptr) {
+    memset(ptr, 0, s->size);
+    return ptr;
+  }
+  if (IW_UNLIKELY(!atomic_load_explicit(&s->registered, memory_order_relaxed))) {
+    _slab_register(s);
+  }
+  return calloc(1, s->size > sizeof(void*) ? s->size : sizeof(void*));
+}
+
+void iwn_slab_free(struct iwn_slab *s, void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  int cap = s->cap > 0 ? s->cap : SLAB_CAP_DEFAULT;
+  struct iwn_slab_stripe *st = _stripe(s);
+  _stripe_lock(st);
+  if (st->cached < cap) {
+    *(void**) ptr = st->free;
+    st->free = ptr;
+    ++st->cached;
+    ptr = 0;
+  } else {
+    ++st->releases;
+  }
+  _stripe_unlock(st);
+  free(ptr);
+}
+
+void iwn_slab_stats(struct iwn_slab *s, struct iwn_slab_stats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  for (int i = 0; i < IWN_SLAB_STRIPES; ++i) {
+    struct iwn_slab_stripe *st = &s->stripes[i];
+    _stripe_lock(st);
+    stats->hits += st->hits;
+    stats->misses += st->misses;
+    stats->releases += st->releases;
+    stats->cached += st->cached;
+    _stripe_unlock(st);
+  }
+}
+
+void iwn_slabs_stats_visit(void (*visitor)(const char*, const struct iwn_slab_stats*, void*), void *op) {
+  struct iwn_slab_stats stats;
+  for (struct iwn_slab *s = atomic_load(&_slabs); s; s = s->next) {
+    iwn_slab_stats(s, &stats);
+    visitor(s->name, &stats, op);
+  }
+}
+
+void iwn_slab_purge(struct iwn_slab *s) {
+  for (int i = 0; i < IWN_SLAB_STRIPES; ++i) {
+    struct iwn_slab_stripe *st = &s->stripes[i];
+    _stripe_lock(st);
+    void *ptr = st->free;
+    st->free = 0;
+    st->cached = 0;
+    _stripe_unlock(st);
+    while (ptr) {
+      void *next = *(void**) ptr;
+      free(ptr);
+      ptr = next;
+    }
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+/// Caches of fixed size objects.
+///
+/// Freed objects are kept in a set of lock striped free lists,
+/// every thread works with its own stripe, so allocations of frequently
+/// created and disposed objects (connections, adapters) bypass system allocator.
+
+#include <iowow/basedefs.h>
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+IW_EXTERN_C_START
+
+#define IWN_SLAB_STRIPES 16
+
+/// Slab stripe. Internal.
+struct iwn_slab_stripe {
+  _Alignas(64) atomic_bool lock;
+  void    *free;      ///< Free objects list
+  int      cached;    ///< Number of objects in free list
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t releases;
+};
+
+/// Slab cache of objects of `size` bytes.
+/// Should be defined as static variable initialized by IWN_SLAB_INITIALIZER().
+struct iwn_slab {
+  const char *name;
+  size_t      size;
+  int cap;                                 ///< Max number of cached objects per stripe
+  atomic_bool registered;
+  struct iwn_slab *next;
+  struct iwn_slab_stripe stripes[IWN_SLAB_STRIPES];
+};
+
+/// Slab statistics.
+struct iwn_slab_stats {
+  uint64_t hits;     ///< Number of allocations served from cache
+  uint64_t misses;   ///< Number of allocations served by system allocator
+  uint64_t releases; ///< Number of objects returned to system allocator since cache was full
+  int      cached;   ///< Number of objects cached at the moment
+};
+
+/// Initializer of slab for objects of `size__` bytes caching up to `cap__` objects per stripe.
+#define IWN_SLAB_INITIALIZER(name__, size__, cap__) { .name = (name__), .size = (size__), .cap = (cap__) }
+
+/// Allocates zero filled object.
+/// Returns zero if allocation failed.
+IW_EXPORT void* iwn_slab_alloc(struct iwn_slab *slab);
+
+/// Returns object allocated by `iwn_slab_alloc()` to the slab.
+IW_EXPORT void iwn_slab_free(struct iwn_slab *slab, void *ptr);
+
+/// Returns slab statistics.
+IW_EXPORT void iwn_slab_stats(struct iwn_slab *slab, struct iwn_slab_stats *stats);
+
+/// Visits statistics of all slabs used so far.
+IW_EXPORT void iwn_slabs_stats_visit(void (*visitor)(const char *name, const struct iwn_slab_stats*, void *op), void *op);
+
+/// Returns all cached objects of slab to system allocator.
+IW_EXPORT void iwn_slab_purge(struct iwn_slab *slab);
+
+IW_EXTERN_C_END
@@ -518,7 +518,7 @@ static iwrc _ws_connect(struct iwn_ws_client *ws) {
       .user_data = ws,
       .timeout_sec = spec->timeout_sec,
       .events = IWN_POLLOUT,
-      .events_mod = IWN_POLLET,
+      .events_mod = IWN_POLLET | IWN_POLLPERSIST,
       .fd = ws->fd,
       .verify_peer = spec->flags & WS_VERIFY_PEER,
       .verify_host = spec->flags & WS_VERIFY_HOST
@@ -528,7 +528,7 @@ static iwrc _ws_connect(struct iwn_ws_client *ws) {
         iwn_direct_poller_adapter(spec->poller, ws->fd,
                                   _on_poller_adapter_event,
                                   _on_poller_adapter_dispose,
-                                  ws, IWN_POLLOUT, IWN_POLLET,
+                                  ws, IWN_POLLOUT, IWN_POLLET | IWN_POLLPERSIST,
                                   spec->timeout_sec));
   }
 